@@ -0,0 +1,72 @@
+// Segment codec benchmark: compression ratio and decode throughput.
+//
+//   g++ -std=c++17 -O3 -march=native -I include bench/codec_bench.cpp -o codec_bench
+//   ./codec_bench [rows]
+#include "../include/Codecs.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+template <typename T>
+static void run(const char* name, const std::vector<T>& column) {
+    std::string encoded = Codec::encode_column(column);
+    size_t raw_bytes = column.size() * sizeof(T);
+
+    std::vector<T> decoded;
+    double best = 1e30;
+    for (int iter = 0; iter < 5; iter++) {
+        auto start = std::chrono::steady_clock::now();
+        Codec::decode(encoded.data(), encoded.size(), decoded);
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+
+    if (decoded != column) {
+        printf("%-12s DECODE MISMATCH\n", name);
+        std::exit(1);
+    }
+
+    const char* codec = encoded[0] == Codec::CODEC_FOR ? "for" :
+                        encoded[0] == Codec::CODEC_DELTA_DELTA ? "delta-delta" : "rle";
+    printf("%-12s %-12s %10zu -> %9zu bytes  %6.1fx  decode %6.2f GB/s\n",
+           name, codec, raw_bytes, encoded.size(), (double)raw_bytes / encoded.size(),
+           raw_bytes / best / 1e9);
+}
+
+int main(int argc, char** argv) {
+    size_t rows = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4000000;
+    std::mt19937_64 rng(42);
+
+    std::vector<int32_t> ids(rows);
+    std::vector<int64_t> timestamps(rows);
+    std::vector<uint64_t> durations(rows), rams(rows);
+    std::vector<uint32_t> func_ids(rows), version_ids(rows);
+
+    std::lognormal_distribution<double> latency(3.0, 1.2);
+    std::normal_distribution<double> ram(48000, 1500);
+    std::uniform_int_distribution<uint32_t> func(1, 3000);
+    std::uniform_int_distribution<int> gap(1, 3);
+
+    int64_t ts = 1760000000;
+    int32_t id = 1;
+    for (size_t i = 0; i < rows; i++) {
+        id += gap(rng);
+        if (rng() % 8 == 0) ts++;
+        ids[i] = id;
+        timestamps[i] = ts;
+        durations[i] = std::min<uint64_t>(3600000, (uint64_t)latency(rng));
+        rams[i] = (uint64_t)std::max(0.0, ram(rng));
+        func_ids[i] = func(rng);
+        version_ids[i] = 1 + (uint32_t)(i * 4 / rows);
+    }
+
+    printf("rows: %zu\n", rows);
+    run("id", ids);
+    run("ts", timestamps);
+    run("duration", durations);
+    run("ram", rams);
+    run("func_id", func_ids);
+    run("version_id", version_ids);
+    return 0;
+}
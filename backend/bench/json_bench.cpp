@@ -0,0 +1,116 @@
+// JSON serialization benchmark: the old std::string concatenation used by
+// the handlers versus JsonWriter, on the /logs row shape.
+//
+//   g++ -std=c++17 -O3 -march=native -I include bench/json_bench.cpp -o json_bench
+//   ./json_bench [rows]
+#include "../include/JsonWriter.hpp"
+#include "../include/Models.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+static std::string concat_json(const std::vector<ExecTrace::TraceEntry>& results) {
+    std::string json = "{\"status\":\"ok\",\"count\":" + std::to_string(results.size()) + ",\"logs\":[";
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& entry = results[i];
+        if (i > 0) json += ",";
+
+        json += "{";
+        json += "\"id\":" + std::to_string(entry.id) + ",";
+        json += "\"project_id\":" + std::to_string(entry.project_id) + ",";
+        json += "\"func\":\"" + std::string(entry.func) + "\",";
+        json += "\"message\":\"" + std::string(entry.message) + "\",";
+        json += "\"app_version\":\"" + std::string(entry.app_version) + "\",";
+        json += "\"duration\":" + std::to_string(entry.duration) + ",";
+        json += "\"ram_usage\":" + std::to_string(entry.ram_usage) + ",";
+        json += "\"timestamp\":" + std::to_string(entry.timestamp);
+        json += "}";
+    }
+    json += "]}";
+    return json;
+}
+
+static void write_logs(JsonWriter& json, const std::vector<ExecTrace::TraceEntry>& results) {
+    json.begin_object();
+    json.key("status").value("ok");
+    json.key("count").value(results.size());
+    json.key("logs").begin_array();
+    for (const auto& entry : results) {
+        json.begin_object();
+        json.key("id").value(entry.id);
+        json.key("project_id").value(entry.project_id);
+        json.key("func").value(entry.func);
+        json.key("message").value(entry.message);
+        json.key("app_version").value(entry.app_version);
+        json.key("duration").value(entry.duration);
+        json.key("ram_usage").value(entry.ram_usage);
+        json.key("timestamp").value(entry.timestamp);
+        json.end_object();
+    }
+    json.end_array().end_object();
+}
+
+static std::string writer_json(const std::vector<ExecTrace::TraceEntry>& results) {
+    JsonWriter json(128 + results.size() * 240);
+    write_logs(json, results);
+    return json.take();
+}
+
+template <typename F>
+static double best_of(F f, size_t& bytes) {
+    double best = 1e30;
+    for (int iter = 0; iter < 5; iter++) {
+        auto start = std::chrono::steady_clock::now();
+        std::string out = f();
+        auto end = std::chrono::steady_clock::now();
+        bytes = out.size();
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    size_t rows = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 500000;
+    std::mt19937_64 rng(42);
+
+    std::vector<ExecTrace::TraceEntry> results;
+    results.reserve(rows);
+    for (size_t i = 0; i < rows; i++) {
+        char func[64], message[128];
+        snprintf(func, sizeof(func), "service::handler_%d", static_cast<int>(rng() % 200));
+        snprintf(message, sizeof(message), "request completed for tenant %d with status ok",
+                 static_cast<int>(rng() % 10000));
+        results.emplace_back(static_cast<int>(i + 1), 1, func, message, "v2.4.1",
+                             rng() % 5000, 1024 + rng() % 65536);
+    }
+
+    size_t concat_bytes = 0, writer_bytes = 0, reused_bytes = 0;
+    double concat = best_of([&] { return concat_json(results); }, concat_bytes);
+    double writer = best_of([&] { return writer_json(results); }, writer_bytes);
+
+    // Same writer appending into a buffer that keeps its capacity, as the
+    // streaming export does with its chunk string.
+    std::string buffer;
+    double reused = best_of([&] {
+        buffer.clear();
+        JsonWriter json(buffer);
+        write_logs(json, results);
+        return std::string();
+    }, reused_bytes);
+    reused_bytes = buffer.size();
+
+    if (concat_bytes != writer_bytes) {
+        printf("OUTPUT SIZE MISMATCH %zu vs %zu\n", concat_bytes, writer_bytes);
+        return 1;
+    }
+
+    printf("%zu rows, %zu bytes\n", rows, writer_bytes);
+    printf("%-8s %8.1f ms  %6.0f MB/s\n", "concat", concat * 1e3, concat_bytes / concat / 1e6);
+    printf("%-8s %8.1f ms  %6.0f MB/s  (%.1fx)\n", "writer", writer * 1e3, writer_bytes / writer / 1e6,
+           concat / writer);
+    printf("%-8s %8.1f ms  %6.0f MB/s  (%.1fx, reused buffer)\n", "writer", reused * 1e3,
+           reused_bytes / reused / 1e6, concat / reused);
+    return 0;
+}
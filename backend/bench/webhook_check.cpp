@@ -0,0 +1,181 @@
+// WebhookSender against a local HTTP stub: batching, retry with backoff,
+// dropping after the last attempt, and the host allowlist. Exits non-zero
+// if any check fails.
+//
+//   g++ -std=c++17 -O2 -I include bench/webhook_check.cpp -o webhook_check -pthread -lboost_system
+//   ./webhook_check
+#include "../include/WebhookSender.hpp"
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// Accepts one request per connection and answers with the next status from
+// `statuses` (the last one repeats), recording when each body arrived.
+class StubServer {
+private:
+    boost::asio::io_context io;
+    boost::asio::ip::tcp::acceptor acceptor;
+    std::vector<int> statuses;
+    std::atomic<bool> stopping;
+    std::thread worker;
+    std::mutex mutex;
+
+    void serve() {
+        namespace asio = boost::asio;
+        while (!stopping) {
+            asio::ip::tcp::socket socket(io);
+            boost::system::error_code ec;
+            acceptor.accept(socket, ec);
+            if (ec || stopping) break;
+
+            asio::streambuf buffer;
+            size_t header_end = asio::read_until(socket, buffer, "\r\n\r\n", ec);
+            if (ec) continue;
+            std::string data(asio::buffers_begin(buffer.data()), asio::buffers_end(buffer.data()));
+            std::string headers = data.substr(0, header_end);
+            size_t length = 0;
+            size_t cl = headers.find("Content-Length: ");
+            if (cl != std::string::npos) length = std::strtoul(headers.c_str() + cl + 16, nullptr, 10);
+            if (buffer.size() < header_end + length) {
+                asio::read(socket, buffer, asio::transfer_exactly(header_end + length - buffer.size()), ec);
+            }
+            std::string all(asio::buffers_begin(buffer.data()), asio::buffers_end(buffer.data()));
+
+            int status;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                status = statuses[std::min(bodies.size(), statuses.size() - 1)];
+                bodies.push_back(all.substr(header_end, length));
+                times.push_back(Clock::now());
+            }
+            std::string response = "HTTP/1.1 " + std::to_string(status) + " Stub\r\n"
+                                   "Content-Length: 0\r\nConnection: close\r\n\r\n";
+            asio::write(socket, asio::buffer(response), ec);
+        }
+    }
+
+public:
+    std::vector<std::string> bodies;
+    std::vector<Clock::time_point> times;
+
+    explicit StubServer(std::vector<int> replies)
+        : acceptor(io, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+          statuses(std::move(replies)), stopping(false) {
+        worker = std::thread(&StubServer::serve, this);
+    }
+
+    ~StubServer() {
+        stopping = true;
+        // Wake the blocking accept
+        boost::system::error_code ec;
+        boost::asio::ip::tcp::socket wake(io);
+        wake.connect(acceptor.local_endpoint(), ec);
+        worker.join();
+    }
+
+    std::string url() const {
+        return "http://127.0.0.1:" + std::to_string(acceptor.local_endpoint().port()) + "/hook";
+    }
+
+    size_t requests() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return bodies.size();
+    }
+};
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+    std::printf("%-52s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok) failures++;
+}
+
+static size_t count_items(const std::string& body) {
+    size_t n = 0;
+    for (size_t pos = body.find("\"n\":"); pos != std::string::npos; pos = body.find("\"n\":", pos + 1)) n++;
+    return n;
+}
+
+static bool wait_for(const std::function<bool()>& done, std::chrono::milliseconds limit) {
+    auto deadline = Clock::now() + limit;
+    while (!done()) {
+        if (Clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return true;
+}
+
+int main() {
+    using std::chrono::milliseconds;
+
+    {
+        StubServer stub({200});
+        WebhookSender sender({"127.0.0.1"}, 3, milliseconds(1000));
+        for (int i = 0; i < 250; i++) sender.enqueue(stub.url(), "{\"n\":" + std::to_string(i) + "}");
+        wait_for([&] { return sender.delivered_count() == 250; }, milliseconds(5000));
+
+        size_t items = 0;
+        bool bounded = true;
+        for (const auto& body : stub.bodies) {
+            items += count_items(body);
+            bounded = bounded && count_items(body) <= 100 && body.compare(0, 11, "{\"alerts\":[") == 0;
+        }
+        check(stub.requests() == 3, "250 alerts are sent as 3 batches");
+        check(bounded && items == 250 && sender.delivered_count() == 250, "batches hold at most 100 alerts, none lost");
+    }
+
+    {
+        StubServer stub({500, 503, 200});
+        WebhookSender sender({"127.0.0.1"}, 5, milliseconds(1000));
+        sender.enqueue(stub.url(), "{\"n\":1}");
+        bool delivered = wait_for([&] { return sender.delivered_count() == 1; }, milliseconds(8000));
+        check(delivered && stub.requests() == 3, "failed batch is retried until it succeeds");
+        if (stub.times.size() == 3) {
+            auto first_gap = std::chrono::duration_cast<milliseconds>(stub.times[1] - stub.times[0]).count();
+            auto second_gap = std::chrono::duration_cast<milliseconds>(stub.times[2] - stub.times[1]).count();
+            check(first_gap >= 900 && second_gap >= 1900, "retries back off 1s, then 2s");
+        } else {
+            check(false, "retries back off 1s, then 2s");
+        }
+    }
+
+    {
+        StubServer stub({500});
+        WebhookSender sender({"127.0.0.1"}, 2, milliseconds(1000));
+        sender.enqueue(stub.url(), "{\"n\":1}");
+        bool dropped = wait_for([&] { return sender.dropped_count() == 1; }, milliseconds(5000));
+        check(dropped && stub.requests() == 2 && sender.delivered_count() == 0, "batch is dropped after max attempts");
+    }
+
+    {
+        StubServer stub({200});
+        std::string port = stub.url().substr(17, stub.url().find('/', 17) - 17);
+        WebhookSender other_port({"127.0.0.1:1"}, 2, milliseconds(1000));
+        WebhookSender other_host({"hooks.example.com"}, 2, milliseconds(1000));
+        WebhookSender exact({"127.0.0.1:" + port}, 2, milliseconds(1000));
+        WebhookSender none({}, 2, milliseconds(1000));
+
+        check(!other_port.allows(stub.url()) && !other_host.allows(stub.url()) && !none.allows(stub.url()),
+              "hosts off the allowlist are refused");
+        check(exact.allows(stub.url()) && other_host.allows("http://HOOKS.example.com/x"),
+              "host and host:port entries match");
+        check(!exact.allows("https://127.0.0.1:" + port + "/") && !exact.allows("http://u@127.0.0.1:" + port + "/"),
+              "non-http and userinfo URLs are refused");
+
+        other_port.enqueue(stub.url(), "{\"n\":1}");
+        none.enqueue(stub.url(), "{\"n\":2}");
+        exact.enqueue(stub.url(), "{\"n\":3}");
+        wait_for([&] { return exact.delivered_count() == 1; }, milliseconds(3000));
+        std::this_thread::sleep_for(milliseconds(300));
+        check(stub.requests() == 1 && count_items(stub.bodies[0]) == 1 && other_port.dropped_count() == 1 &&
+              none.dropped_count() == 1, "refused alerts never reach the network");
+    }
+
+    std::printf("%s\n", failures ? "FAILED" : "all checks passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,380 @@
+#pragma once
+#include "Models.hpp"
+#include "QuantileSketch.hpp"
+#include "Utils.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+enum AlertMetric {
+    ALERT_COUNT,
+    ALERT_AVG,
+    ALERT_MAX,
+    ALERT_P50,
+    ALERT_P90,
+    ALERT_P95,
+    ALERT_P99,
+    ALERT_RATE    // share of calls whose message contains `message`
+};
+
+// One alert rule, written as
+//
+//   <metric>[(<filter>, ...)] <op> <threshold>[ms|s|%] [over <n>[s|m|h]]
+//
+// e.g. "p95(func=checkout) > 200ms over 5m" or
+// "rate(message=~timeout) > 1% over 10m"; "error rate of <filter>, ..."
+// is accepted for rate(). Filters are `func=<name>` (exact) and
+// `message=~<text>` (substring), sanitized like ingested traces. For rate()
+// the message filter picks the counted calls; for other metrics it
+// restricts which calls are measured. The window defaults to 5m.
+struct AlertRule {
+    int id;
+    int project_id;
+    std::string expression;
+    std::string webhook;
+
+    AlertMetric metric;
+    std::string func;
+    std::string message;
+    bool above;          // fire when value > threshold (or >=), else < (or <=)
+    bool inclusive;
+    double threshold;
+    int64_t window;      // seconds
+
+    AlertRule() : id(0), project_id(0), metric(ALERT_COUNT), above(true), inclusive(false),
+                  threshold(0), window(300) {}
+
+    static std::string trim(const std::string& s) {
+        size_t b = s.find_first_not_of(" \t");
+        size_t e = s.find_last_not_of(" \t");
+        return b == std::string::npos ? "" : s.substr(b, e - b + 1);
+    }
+
+    static bool parse_metric(const std::string& name, AlertMetric& out) {
+        static const std::pair<const char*, AlertMetric> names[] = {
+            {"count", ALERT_COUNT}, {"avg", ALERT_AVG}, {"max", ALERT_MAX}, {"p50", ALERT_P50},
+            {"p90", ALERT_P90}, {"p95", ALERT_P95}, {"p99", ALERT_P99}, {"rate", ALERT_RATE}
+        };
+        for (const auto& n : names) {
+            if (name == n.first) {
+                out = n.second;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Fills the parsed fields from `expression`; returns an error message
+    // or an empty string.
+    std::string parse() {
+        std::string expr = trim(expression);
+        size_t op_pos = expr.find_first_of("<>");
+        if (op_pos == std::string::npos) return "Missing comparison (> or <)";
+
+        std::string lhs = trim(expr.substr(0, op_pos));
+        above = expr[op_pos] == '>';
+        inclusive = op_pos + 1 < expr.size() && expr[op_pos + 1] == '=';
+        std::string rhs = trim(expr.substr(op_pos + (inclusive ? 2 : 1)));
+
+        std::string name = lhs;
+        std::string filter_list;
+        size_t paren = lhs.find('(');
+        if (lhs.compare(0, 14, "error rate of ") == 0) {
+            name = "rate";
+            filter_list = lhs.substr(14);
+        } else if (paren != std::string::npos) {
+            if (lhs.back() != ')') return "Unbalanced parentheses";
+            name = trim(lhs.substr(0, paren));
+            filter_list = lhs.substr(paren + 1, lhs.size() - paren - 2);
+        }
+
+        std::stringstream filters(filter_list);
+        std::string filter;
+        while (std::getline(filters, filter, ',')) {
+            filter = trim(filter);
+            if (filter.empty()) continue;
+            if (filter.compare(0, 5, "func=") == 0) {
+                func = ExecTrace::sanitize_string(trim(filter.substr(5)), 128);
+            } else if (filter.compare(0, 9, "message=~") == 0) {
+                message = ExecTrace::sanitize_string(trim(filter.substr(9)), 256);
+            } else {
+                return "Unknown filter: " + filter;
+            }
+        }
+        if (!parse_metric(name, metric)) return "Unknown metric: " + name;
+        if (metric == ALERT_RATE && message.empty()) return "rate() needs a message=~ filter";
+
+        size_t over = rhs.find(" over ");
+        std::string value = trim(rhs.substr(0, over));
+
+        char* end = nullptr;
+        threshold = std::strtod(value.c_str(), &end);
+        if (end == value.c_str()) return "Invalid threshold";
+        std::string unit = trim(end);
+        if (unit == "s") {
+            threshold *= 1000;
+        } else if (unit == "%") {
+            threshold /= 100;
+        } else if (!unit.empty() && unit != "ms") {
+            return "Unknown threshold unit: " + unit;
+        }
+
+        window = 300;
+        if (over != std::string::npos) {
+            std::string span = trim(rhs.substr(over + 6));
+            window = std::strtoll(span.c_str(), &end, 10);
+            std::string window_unit = trim(end);
+            if (window_unit == "m") {
+                window *= 60;
+            } else if (window_unit == "h") {
+                window *= 3600;
+            } else if (window_unit != "s" && !window_unit.empty()) {
+                return "Unknown window unit: " + window_unit;
+            }
+        }
+        if (window < 10 || window > 86400) return "Window must be between 10s and 24h";
+        return "";
+    }
+
+    bool matches(const ExecTrace::TraceEntry& entry) const {
+        if (!func.empty() && func != entry.func) return false;
+        if (metric != ALERT_RATE && !message.empty() && !strstr(entry.message, message.c_str())) return false;
+        return true;
+    }
+};
+
+// A rule changing state, handed to whoever delivers notifications.
+struct AlertEvent {
+    int rule_id;
+    int project_id;
+    std::string expression;
+    std::string webhook;
+    bool firing;
+    double value;
+    double threshold;
+    int64_t timestamp;
+};
+
+// Evaluates alert rules over the live ingest stream. Every rule keeps a ring
+// of SLICES time slices covering its window; observe() adds a trace to the
+// current slice of each matching rule and evaluate() merges the live
+// slices, so nothing is re-read from storage. A rule emits an AlertEvent
+// when it starts firing and when it resolves.
+//
+// Rules are persisted one per line (id, project, webhook, expression,
+// tab separated) and reloaded on startup; window state starts empty.
+class AlertEngine {
+private:
+    static const int SLICES = 30;
+
+    struct Slice {
+        int64_t start;
+        uint64_t count;
+        uint64_t matched;
+        uint64_t sum;
+        uint64_t max;
+        LatencySketch sketch;
+
+        Slice() : start(INT64_MIN), count(0), matched(0), sum(0), max(0) {}
+    };
+
+    struct RuleState {
+        AlertRule rule;
+        int64_t slice_seconds;
+        std::vector<Slice> slices;
+        bool firing;
+
+        RuleState(const AlertRule& r)
+            : rule(r), slice_seconds((r.window + SLICES - 1) / SLICES), slices(SLICES), firing(false) {}
+
+        // Null for a trace older than what its ring slot now holds.
+        Slice* slice_for(int64_t ts) {
+            int64_t start = ts - ((ts % slice_seconds) + slice_seconds) % slice_seconds;
+            Slice& s = slices[static_cast<size_t>((start / slice_seconds) % SLICES + SLICES) % SLICES];
+            if (s.start > start) return nullptr;
+            if (s.start != start) {
+                s = Slice();
+                s.start = start;
+            }
+            return &s;
+        }
+    };
+
+    std::string path;
+    std::map<int, RuleState> rules;
+    std::map<int, std::vector<int>> by_project;
+    int next_rule_id;
+
+    void index_rule(const AlertRule& rule) {
+        rules.emplace(rule.id, RuleState(rule));
+        by_project[rule.project_id].push_back(rule.id);
+        next_rule_id = std::max(next_rule_id, rule.id + 1);
+    }
+
+    bool save() const {
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::trunc);
+            if (!out.is_open()) return false;
+            for (const auto& r : rules) {
+                const AlertRule& rule = r.second.rule;
+                out << rule.id << '\t' << rule.project_id << '\t' << rule.webhook << '\t'
+                    << rule.expression << '\n';
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp, path, ec);
+        return !ec;
+    }
+
+    void load() {
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            std::stringstream fields(line);
+            std::string id, project, webhook;
+            AlertRule rule;
+            if (!std::getline(fields, id, '\t') || !std::getline(fields, project, '\t') ||
+                !std::getline(fields, webhook, '\t') || !std::getline(fields, rule.expression)) {
+                continue;
+            }
+            rule.id = std::atoi(id.c_str());
+            rule.project_id = std::atoi(project.c_str());
+            rule.webhook = webhook;
+            if (!rule.parse().empty()) {
+                std::cerr << "[AlertEngine] Skipping invalid rule " << rule.id << ": " << rule.expression << std::endl;
+                continue;
+            }
+            index_rule(rule);
+        }
+        std::cout << "[AlertEngine] Loaded " << rules.size() << " alert rules" << std::endl;
+    }
+
+    // Value of the rule's metric over the live slices; false if no calls.
+    static bool measure(const RuleState& state, int64_t now, double& value) {
+        Slice total;
+        int64_t oldest = now - state.rule.window;
+        for (const auto& s : state.slices) {
+            if (s.start == INT64_MIN || s.start + state.slice_seconds <= oldest || s.start > now) continue;
+            total.count += s.count;
+            total.matched += s.matched;
+            total.sum += s.sum;
+            total.max = std::max(total.max, s.max);
+            total.sketch.merge(s.sketch);
+        }
+
+        switch (state.rule.metric) {
+            case ALERT_COUNT: value = static_cast<double>(total.count); return true;
+            case ALERT_RATE:  value = total.count ? static_cast<double>(total.matched) / total.count : 0; break;
+            case ALERT_AVG:   value = total.count ? static_cast<double>(total.sum) / total.count : 0; break;
+            case ALERT_MAX:   value = static_cast<double>(total.max); break;
+            case ALERT_P50:   value = static_cast<double>(total.sketch.quantile(0.50)); break;
+            case ALERT_P90:   value = static_cast<double>(total.sketch.quantile(0.90)); break;
+            case ALERT_P95:   value = static_cast<double>(total.sketch.quantile(0.95)); break;
+            case ALERT_P99:   value = static_cast<double>(total.sketch.quantile(0.99)); break;
+        }
+        return total.count > 0;
+    }
+
+public:
+    AlertEngine(const std::string& rules_file) : path(rules_file), next_rule_id(1) {
+        load();
+    }
+
+    // Returns the new rule id, or 0 with `error` set.
+    int add_rule(AlertRule rule, std::string& error) {
+        error = rule.parse();
+        if (!error.empty()) return 0;
+        rule.id = next_rule_id;
+        index_rule(rule);
+        if (!save()) std::cerr << "[AlertEngine] Failed to save rules to " << path << std::endl;
+        return rule.id;
+    }
+
+    bool remove_rule(int project_id, int rule_id) {
+        auto it = rules.find(rule_id);
+        if (it == rules.end() || it->second.rule.project_id != project_id) return false;
+        rules.erase(it);
+        auto& ids = by_project[project_id];
+        ids.erase(std::remove(ids.begin(), ids.end(), rule_id), ids.end());
+        save();
+        return true;
+    }
+
+    // Drops every rule of a deleted project; returns how many there were.
+    size_t remove_project(int project_id) {
+        auto p = by_project.find(project_id);
+        if (p == by_project.end()) return 0;
+        size_t removed = p->second.size();
+        for (int id : p->second) rules.erase(id);
+        by_project.erase(p);
+        if (!save()) std::cerr << "[AlertEngine] Failed to save rules to " << path << std::endl;
+        return removed;
+    }
+
+    std::vector<std::pair<AlertRule, bool>> list(int project_id) const {
+        std::vector<std::pair<AlertRule, bool>> result;
+        auto p = by_project.find(project_id);
+        if (p == by_project.end()) return result;
+        for (int id : p->second) {
+            const RuleState& state = rules.at(id);
+            result.emplace_back(state.rule, state.firing);
+        }
+        return result;
+    }
+
+    void observe(const ExecTrace::TraceEntry& entry) {
+        auto p = by_project.find(entry.project_id);
+        if (p == by_project.end()) return;
+
+        for (int id : p->second) {
+            RuleState& state = rules.at(id);
+            if (!state.rule.matches(entry)) continue;
+
+            Slice* s = state.slice_for(static_cast<int64_t>(entry.timestamp));
+            if (!s) continue;
+            s->count++;
+            if (state.rule.metric == ALERT_RATE) {
+                if (strstr(entry.message, state.rule.message.c_str())) s->matched++;
+            } else {
+                s->sum += entry.duration;
+                s->max = std::max(s->max, entry.duration);
+                if (state.rule.metric >= ALERT_P50) s->sketch.add(entry.duration);
+            }
+        }
+    }
+
+    // Re-evaluates every rule at `now` and returns the state changes.
+    std::vector<AlertEvent> evaluate(int64_t now) {
+        std::vector<AlertEvent> events;
+        for (auto& r : rules) {
+            RuleState& state = r.second;
+            const AlertRule& rule = state.rule;
+
+            double value = 0;
+            bool breached = false;
+            if (measure(state, now, value)) {
+                if (rule.above) {
+                    breached = rule.inclusive ? value >= rule.threshold : value > rule.threshold;
+                } else {
+                    breached = rule.inclusive ? value <= rule.threshold : value < rule.threshold;
+                }
+            }
+            if (breached == state.firing) continue;
+
+            state.firing = breached;
+            events.push_back(AlertEvent{rule.id, rule.project_id, rule.expression, rule.webhook,
+                                        breached, value, rule.threshold, now});
+            std::cout << "[AlertEngine] Rule " << rule.id << " " << (breached ? "firing" : "resolved")
+                      << ": " << rule.expression << " (value " << value << ")" << std::endl;
+        }
+        return events;
+    }
+};
@@ -0,0 +1,123 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+enum AnomalyReason {
+    ANOMALY_SLOW = 1,    // above the project's normal_threshold
+    ANOMALY_ZSCORE = 2   // far above the function's recent mean
+};
+
+struct AnomalyVerdict {
+    uint32_t reasons;
+    double z_score;
+
+    AnomalyVerdict() : reasons(0), z_score(0) {}
+};
+
+// Running view of one function: EWMA mean/variance of its duration over
+// `samples` observations, plus call counters since the process started.
+struct FunctionBaseline {
+    double mean;
+    double variance;
+    uint64_t samples;
+    uint64_t calls;
+    uint64_t slow_calls;
+    uint64_t flagged;
+
+    FunctionBaseline() : mean(0), variance(0), samples(0), calls(0), slow_calls(0), flagged(0) {}
+
+    double stddev() const {
+        return std::sqrt(variance);
+    }
+};
+
+// Per-project duration thresholds, as configured in the project settings.
+struct ProjectThresholds {
+    int project_id;
+    int fast;
+    int normal;
+};
+
+// Online anomaly detector for the ingest path. Each event costs three hash
+// lookups (thresholds, project, function) and a few floating point
+// operations; nothing touches the disk.
+//
+// A trace is flagged when its duration is above the project's
+// normal_threshold (ANOMALY_SLOW) or when it is more than `z_bound`
+// standard deviations above its function's exponentially weighted mean
+// (ANOMALY_ZSCORE). The z-score is taken against the baseline before the
+// event is folded in, and only once the baseline has `warmup` samples.
+class AnomalyDetector {
+private:
+    struct Thresholds {
+        int fast;
+        int normal;
+    };
+
+    double alpha;
+    double z_bound;
+    uint64_t warmup;
+    std::unordered_map<int, Thresholds> thresholds;
+    std::unordered_map<int, std::unordered_map<uint32_t, FunctionBaseline>> baselines;
+
+    void update(FunctionBaseline& b, double x) {
+        if (b.samples++ == 0) {
+            b.mean = x;
+            b.variance = 0;
+            return;
+        }
+        double diff = x - b.mean;
+        b.mean += alpha * diff;
+        b.variance = (1 - alpha) * (b.variance + alpha * diff * diff);
+    }
+
+public:
+    AnomalyDetector(double smoothing = 0.05, double z_limit = 4.0, uint64_t warmup_calls = 30)
+        : alpha(smoothing), z_bound(z_limit), warmup(warmup_calls) {}
+
+    void set_thresholds(int project_id, int fast_threshold, int normal_threshold) {
+        thresholds[project_id] = Thresholds{fast_threshold, normal_threshold};
+    }
+
+    int normal_threshold(int project_id) const {
+        auto it = thresholds.find(project_id);
+        return it == thresholds.end() ? 500 : it->second.normal;
+    }
+
+    AnomalyVerdict observe(int project_id, uint32_t func_id, uint64_t duration) {
+        AnomalyVerdict verdict;
+        FunctionBaseline& b = baselines[project_id][func_id];
+        double x = static_cast<double>(duration);
+
+        if (duration > static_cast<uint64_t>(std::max(0, normal_threshold(project_id)))) {
+            verdict.reasons |= ANOMALY_SLOW;
+            b.slow_calls++;
+        }
+        if (b.samples >= warmup && b.variance > 0) {
+            verdict.z_score = (x - b.mean) / b.stddev();
+            if (verdict.z_score > z_bound) verdict.reasons |= ANOMALY_ZSCORE;
+        }
+        if (verdict.reasons) b.flagged++;
+
+        update(b, x);
+        b.calls++;
+        return verdict;
+    }
+
+    // Folds a historical duration into the baseline without counting it,
+    // so z-scores work right after a restart.
+    void warm(int project_id, uint32_t func_id, uint64_t duration) {
+        update(baselines[project_id][func_id], static_cast<double>(duration));
+    }
+
+    std::vector<std::pair<uint32_t, FunctionBaseline>> functions(int project_id) const {
+        std::vector<std::pair<uint32_t, FunctionBaseline>> result;
+        auto it = baselines.find(project_id);
+        if (it == baselines.end()) return result;
+        for (const auto& f : it->second) result.push_back(f);
+        return result;
+    }
+};
@@ -211,6 +211,18 @@ public:
         return false;
     }
 
+    bool get_project_by_api_key(const std::string& api_key, ExecTrace::ProjectEntry& out_project) {
+        std::lock_guard<std::mutex> lock(auth_mutex);
+
+        for (const auto& project : project_tree->get_all_values()) {
+            if (strcmp(project.api_key, api_key.c_str()) == 0 && !project.is_deleted) {
+                out_project = project;
+                return true;
+            }
+        }
+        return false;
+    }
+
     std::vector<ExecTrace::ProjectEntry> get_projects_by_user(int user_id) {
         std::lock_guard<std::mutex> lock(auth_mutex);
         
@@ -228,6 +240,16 @@ public:
         return user_projects;
     }
 
+    std::vector<ExecTrace::ProjectEntry> get_all_projects() {
+        std::lock_guard<std::mutex> lock(auth_mutex);
+
+        std::vector<ExecTrace::ProjectEntry> projects;
+        for (const auto& project : project_tree->get_all_values()) {
+            if (!project.is_deleted) projects.push_back(project);
+        }
+        return projects;
+    }
+
     bool update_project_settings(int project_id, int fast_threshold, int normal_threshold) {
         std::lock_guard<std::mutex> lock(auth_mutex);
 
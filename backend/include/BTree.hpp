@@ -3,6 +3,7 @@
 #include "Models.hpp"
 #include <vector>
 #include <algorithm>
+#include <functional>
 
 using namespace ExecTrace;
 
@@ -132,13 +133,16 @@ public:
         Node<T> root = load_node(root_page_id);
         
         if (root.entries.size() == Node<T>::MAX_KEYS) {
-            
-            int new_root_id = dm->allocate_page();
-            Node<T> new_root(new_root_id, false);
-            new_root.children.push_back(root_page_id);
+            // Move the full root to a fresh page and grow a new root in its
+            // place, so the root always lives at page 0 across restarts
+            Node<T> moved = root;
+            moved.page_id = dm->allocate_page();
+            save_node(moved);
+
+            Node<T> new_root(root_page_id, false);
+            new_root.children.push_back(moved.page_id);
             
             split_child(new_root, 0);
-            root_page_id = new_root_id;
             save_node(new_root);
             
             insert_non_full(new_root, entry);
@@ -151,6 +155,31 @@ public:
         return search_node(root_page_id, key);
     }
 
+    // Removes the entry equal to `key`. Nodes on the way down are topped up
+    // from a sibling or merged with one first, so no node underflows; when
+    // the root runs out of entries its only child is moved to page 0.
+    bool remove(const T& key) {
+        Node<T> root = load_node(root_page_id);
+        bool removed = remove_from(root, key);
+        if (!root.is_leaf && root.entries.empty() && !root.children.empty()) {
+            Node<T> child = load_node(root.children[0]);
+            child.page_id = root_page_id;
+            save_node(child);
+        }
+        return removed;
+    }
+
+    // In-order visit of entries with lo <= e <= hi, descending only into
+    // subtrees that can overlap the range. Return false from `visit` to stop.
+    void scan_range(const T& lo, const T& hi, const std::function<bool(const T&)>& visit) {
+        scan_range_node(root_page_id, lo, hi, visit);
+    }
+
+    // Same as scan_range but from hi down to lo.
+    void scan_range_reverse(const T& lo, const T& hi, const std::function<bool(const T&)>& visit) {
+        scan_range_reverse_node(root_page_id, lo, hi, visit);
+    }
+
 private:
     Node<T> load_node(int page_id) {
         char buffer[PAGE_SIZE];
@@ -233,6 +262,145 @@ private:
         save_node(parent);
     }
 
+    bool remove_from(Node<T>& node, const T& key) {
+        const size_t min_keys = Node<T>::DEGREE - 1;
+        size_t i = 0;
+        while (i < node.entries.size() && node.entries[i] < key) i++;
+        bool here = i < node.entries.size() && node.entries[i] == key;
+
+        if (node.is_leaf) {
+            if (!here) return false;
+            node.entries.erase(node.entries.begin() + i);
+            save_node(node);
+            return true;
+        }
+        if (node.children.size() != node.entries.size() + 1) return false;
+
+        if (here) {
+            // Replace the entry with its predecessor or successor, or pull
+            // it down into the merged children and remove it there
+            Node<T> left = load_node(node.children[i]);
+            if (left.entries.size() > min_keys) {
+                T pred = last_entry(left);
+                node.entries[i] = pred;
+                save_node(node);
+                return remove_from(left, pred);
+            }
+            Node<T> right = load_node(node.children[i + 1]);
+            if (right.entries.size() > min_keys) {
+                T succ = first_entry(right);
+                node.entries[i] = succ;
+                save_node(node);
+                return remove_from(right, succ);
+            }
+            merge_children(node, i, left, right);
+            return remove_from(left, key);
+        }
+
+        Node<T> child = load_node(node.children[i]);
+        if (child.entries.size() <= min_keys) {
+            Node<T> left, right;
+            bool has_left = i > 0, has_right = i + 1 < node.children.size();
+            if (has_left) left = load_node(node.children[i - 1]);
+            if (has_right) right = load_node(node.children[i + 1]);
+
+            if (has_left && left.entries.size() > min_keys) {
+                child.entries.insert(child.entries.begin(), node.entries[i - 1]);
+                node.entries[i - 1] = left.entries.back();
+                left.entries.pop_back();
+                if (!left.is_leaf) {
+                    child.children.insert(child.children.begin(), left.children.back());
+                    left.children.pop_back();
+                }
+                save_node(left);
+                save_node(child);
+                save_node(node);
+            } else if (has_right && right.entries.size() > min_keys) {
+                child.entries.push_back(node.entries[i]);
+                node.entries[i] = right.entries.front();
+                right.entries.erase(right.entries.begin());
+                if (!right.is_leaf) {
+                    child.children.push_back(right.children.front());
+                    right.children.erase(right.children.begin());
+                }
+                save_node(right);
+                save_node(child);
+                save_node(node);
+            } else if (has_right) {
+                merge_children(node, i, child, right);
+            } else if (has_left) {
+                merge_children(node, i - 1, left, child);
+                child = left;
+            }
+        }
+        return remove_from(child, key);
+    }
+
+    // Folds entry `index` of `parent` and its right child into its left
+    // child. The right child's page is left unused.
+    void merge_children(Node<T>& parent, size_t index, Node<T>& left, const Node<T>& right) {
+        left.entries.push_back(parent.entries[index]);
+        left.entries.insert(left.entries.end(), right.entries.begin(), right.entries.end());
+        left.children.insert(left.children.end(), right.children.begin(), right.children.end());
+        parent.entries.erase(parent.entries.begin() + index);
+        parent.children.erase(parent.children.begin() + index + 1);
+        save_node(left);
+        save_node(parent);
+    }
+
+    T first_entry(Node<T> node) {
+        while (!node.is_leaf) node = load_node(node.children.front());
+        return node.entries.front();
+    }
+
+    T last_entry(Node<T> node) {
+        while (!node.is_leaf) node = load_node(node.children.back());
+        return node.entries.back();
+    }
+
+    bool scan_range_node(int page_id, const T& lo, const T& hi,
+                         const std::function<bool(const T&)>& visit) {
+        Node<T> node = load_node(page_id);
+        size_t n = node.entries.size();
+
+        for (size_t i = 0; i <= n; i++) {
+            // children[i] holds keys between entries[i-1] and entries[i]
+            bool child_relevant = !node.is_leaf && i < node.children.size() &&
+                                  (i == n || !(node.entries[i] < lo)) &&
+                                  (i == 0 || !(node.entries[i - 1] > hi));
+            if (child_relevant && !scan_range_node(node.children[i], lo, hi, visit)) {
+                return false;
+            }
+            if (i == n) break;
+
+            const T& e = node.entries[i];
+            if (e > hi) return false;
+            if (!(e < lo) && !visit(e)) return false;
+        }
+        return true;
+    }
+
+    bool scan_range_reverse_node(int page_id, const T& lo, const T& hi,
+                                 const std::function<bool(const T&)>& visit) {
+        Node<T> node = load_node(page_id);
+        size_t n = node.entries.size();
+
+        for (size_t k = n + 1; k-- > 0;) {
+            bool child_relevant = !node.is_leaf && k < node.children.size() &&
+                                  (k == n || !(node.entries[k] < lo)) &&
+                                  (k == 0 || !(node.entries[k - 1] > hi));
+            if (child_relevant && !scan_range_reverse_node(node.children[k], lo, hi, visit)) {
+                return false;
+            }
+            if (k == 0) break;
+
+            const T& e = node.entries[k - 1];
+            if (e < lo) return false;
+            if (!(e > hi) && !visit(e)) return false;
+        }
+        return true;
+    }
+
     std::vector<T> search_node(int page_id, const T& key) {
         Node<T> node = load_node(page_id);
         std::vector<T> results;
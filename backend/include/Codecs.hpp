@@ -0,0 +1,264 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// Column codecs for sealed segments. Every encoded column starts with
+//   [codec:u8][count:u64]
+// followed by a codec-specific body:
+//   CODEC_FOR          [packed: base + bit-packed offsets]
+//   CODEC_DELTA_DELTA  [first:i64][first_delta:i64][packed zigzag(dd)]
+//   CODEC_RLE          [runs:u64][packed run values][packed run lengths]
+// where "packed" is [base:u64][width:u8][bytes] with 8 bytes of tail
+// padding so decoders can always do a full unaligned 64-bit load.
+//
+// Decoders are written as straight-line loops with no data-dependent
+// branches: each output lane depends only on its index, so the unpack loops
+// auto-vectorize, and delta/run expansion is a separate prefix-sum/fill pass.
+namespace Codec {
+
+enum Type : uint8_t {
+    CODEC_FOR = 1,
+    CODEC_DELTA_DELTA = 2,
+    CODEC_RLE = 3
+};
+
+const size_t PACK_PADDING = 8;
+
+inline int bit_width(uint64_t v) {
+    int w = 0;
+    while (v) {
+        w++;
+        v >>= 1;
+    }
+    return w;
+}
+
+inline uint64_t zigzag(int64_t v) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+inline int64_t unzigzag(uint64_t v) {
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+template <typename T>
+inline void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+inline bool get(const char*& p, const char* end, T& value) {
+    if (p + sizeof(T) > end) return false;
+    memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+}
+
+// Frame of reference + bit packing of n values.
+inline void pack(const uint64_t* values, size_t n, std::string& out) {
+    uint64_t base = n ? *std::min_element(values, values + n) : 0;
+    uint64_t max_offset = 0;
+    for (size_t i = 0; i < n; i++) {
+        max_offset = std::max(max_offset, values[i] - base);
+    }
+    int width = bit_width(max_offset);
+
+    put<uint64_t>(out, base);
+    put<uint8_t>(out, static_cast<uint8_t>(width));
+
+    size_t bytes = (n * width + 7) / 8 + PACK_PADDING;
+    size_t start = out.size();
+    out.resize(start + bytes, '\0');
+    unsigned char* dst = reinterpret_cast<unsigned char*>(&out[start]);
+
+    for (size_t i = 0; i < n && width > 0; i++) {
+        uint64_t v = values[i] - base;
+        size_t bit = i * width;
+        for (int b = 0; b < width; b += 8) {
+            size_t pos = bit + b;
+            uint64_t chunk = (v >> b) & 0xFF;
+            int take = std::min(8, width - b);
+            chunk &= (1u << take) - 1;
+            dst[pos >> 3] |= static_cast<unsigned char>(chunk << (pos & 7));
+            if ((pos & 7) + take > 8) {
+                dst[(pos >> 3) + 1] |= static_cast<unsigned char>(chunk >> (8 - (pos & 7)));
+            }
+        }
+    }
+}
+
+// Unpacks n values written by pack() into out[0..n). Returns a pointer past
+// the packed block, or nullptr if the input is truncated.
+template <typename T>
+inline const char* unpack(const char* p, const char* end, size_t n, T* out) {
+    uint64_t base;
+    uint8_t width;
+    if (!get(p, end, base) || !get(p, end, width) || width > 64) return nullptr;
+
+    size_t bytes = (n * width + 7) / 8 + PACK_PADDING;
+    if (p + bytes > end) return nullptr;
+
+    if (width == 0) {
+        for (size_t i = 0; i < n; i++) out[i] = static_cast<T>(base);
+    } else if (width <= 56) {
+        const uint64_t mask = (1ULL << width) - 1;
+        for (size_t i = 0; i < n; i++) {
+            size_t bit = i * width;
+            uint64_t word;
+            memcpy(&word, p + (bit >> 3), sizeof(word));
+            out[i] = static_cast<T>(base + ((word >> (bit & 7)) & mask));
+        }
+    } else {
+        const uint64_t mask = width == 64 ? ~0ULL : (1ULL << width) - 1;
+        for (size_t i = 0; i < n; i++) {
+            size_t bit = i * width;
+            int shift = bit & 7;
+            uint64_t word;
+            memcpy(&word, p + (bit >> 3), sizeof(word));
+            uint64_t spill = static_cast<unsigned char>(p[(bit >> 3) + 8]);
+            uint64_t v = (word >> shift) | (shift ? spill << (64 - shift) : 0);
+            out[i] = static_cast<T>(base + (v & mask));
+        }
+    }
+    return p + bytes;
+}
+
+inline void encode_for(const std::vector<uint64_t>& values, std::string& out) {
+    put<uint8_t>(out, CODEC_FOR);
+    put<uint64_t>(out, values.size());
+    pack(values.data(), values.size(), out);
+}
+
+inline void encode_delta_delta(const std::vector<uint64_t>& values, std::string& out) {
+    size_t n = values.size();
+    put<uint8_t>(out, CODEC_DELTA_DELTA);
+    put<uint64_t>(out, n);
+
+    int64_t first = n > 0 ? static_cast<int64_t>(values[0]) : 0;
+    int64_t first_delta = n > 1 ? static_cast<int64_t>(values[1] - values[0]) : 0;
+    put<int64_t>(out, first);
+    put<int64_t>(out, first_delta);
+
+    // Wrapping unsigned arithmetic; the round trip is exact modulo 2^64
+    std::vector<uint64_t> dd(n > 2 ? n - 2 : 0);
+    uint64_t prev_delta = static_cast<uint64_t>(first_delta);
+    for (size_t i = 2; i < n; i++) {
+        uint64_t delta = values[i] - values[i - 1];
+        dd[i - 2] = zigzag(static_cast<int64_t>(delta - prev_delta));
+        prev_delta = delta;
+    }
+    pack(dd.data(), dd.size(), out);
+}
+
+inline void encode_rle(const std::vector<uint64_t>& values, std::string& out) {
+    std::vector<uint64_t> run_values, run_lengths;
+    for (size_t i = 0; i < values.size();) {
+        size_t j = i + 1;
+        while (j < values.size() && values[j] == values[i]) j++;
+        run_values.push_back(values[i]);
+        run_lengths.push_back(j - i);
+        i = j;
+    }
+
+    put<uint8_t>(out, CODEC_RLE);
+    put<uint64_t>(out, values.size());
+    put<uint64_t>(out, run_values.size());
+    pack(run_values.data(), run_values.size(), out);
+    pack(run_lengths.data(), run_lengths.size(), out);
+}
+
+// Encodes with whichever codec gives the smallest output.
+inline std::string encode(const std::vector<uint64_t>& values) {
+    std::string best, candidate;
+    encode_for(values, best);
+
+    encode_delta_delta(values, candidate);
+    if (candidate.size() < best.size()) best.swap(candidate);
+
+    candidate.clear();
+    encode_rle(values, candidate);
+    if (candidate.size() < best.size()) best.swap(candidate);
+
+    return best;
+}
+
+template <typename T>
+inline std::string encode_column(const std::vector<T>& column) {
+    std::vector<uint64_t> values(column.size());
+    for (size_t i = 0; i < column.size(); i++) {
+        values[i] = static_cast<uint64_t>(column[i]);
+    }
+    return encode(values);
+}
+
+template <typename T>
+inline bool decode(const char* data, size_t length, std::vector<T>& out) {
+    const char* p = data;
+    const char* end = data + length;
+    uint8_t codec;
+    uint64_t n;
+    if (!get(p, end, codec) || !get(p, end, n)) return false;
+
+    out.resize(n);
+    switch (codec) {
+        case CODEC_FOR:
+            return unpack(p, end, n, out.data()) != nullptr;
+
+        case CODEC_DELTA_DELTA: {
+            int64_t first, first_delta;
+            if (!get(p, end, first) || !get(p, end, first_delta)) return false;
+            if (n == 0) return true;
+
+            // Vectorizable unpack of zigzag(dd), then the prefix-sum pass.
+            // 64-bit columns unpack straight into out[2..n) to skip a buffer.
+            std::vector<uint64_t> scratch;
+            uint64_t* dd;
+            if (sizeof(T) == sizeof(uint64_t)) {
+                dd = reinterpret_cast<uint64_t*>(out.data()) + 2;
+            } else {
+                scratch.resize(n > 2 ? n - 2 : 0);
+                dd = scratch.data();
+            }
+            if (!unpack(p, end, n > 2 ? n - 2 : 0, dd)) return false;
+
+            uint64_t value = static_cast<uint64_t>(first);
+            uint64_t delta = static_cast<uint64_t>(first_delta);
+            out[0] = static_cast<T>(value);
+            if (n > 1) {
+                value += delta;
+                out[1] = static_cast<T>(value);
+            }
+            for (size_t i = 2; i < n; i++) {
+                delta += static_cast<uint64_t>(unzigzag(dd[i - 2]));
+                value += delta;
+                out[i] = static_cast<T>(value);
+            }
+            return true;
+        }
+
+        case CODEC_RLE: {
+            uint64_t runs;
+            if (!get(p, end, runs)) return false;
+            std::vector<T> values(runs);
+            std::vector<uint64_t> lengths(runs);
+            p = unpack(p, end, runs, values.data());
+            if (!p || !unpack(p, end, runs, lengths.data())) return false;
+
+            size_t pos = 0;
+            for (size_t r = 0; r < runs; r++) {
+                if (pos + lengths[r] > n) return false;
+                std::fill(out.begin() + pos, out.begin() + pos + lengths[r], values[r]);
+                pos += lengths[r];
+            }
+            return pos == n;
+        }
+
+        default:
+            return false;
+    }
+}
+
+}
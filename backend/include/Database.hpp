@@ -1,77 +1,1623 @@
 #pragma once
-#include "BTree.hpp"
+#include "TraceHeap.hpp"
+#include "StringDictionary.hpp"
+#include "SegmentStore.hpp"
+#include "ProjectStatsStore.hpp"
+#include "RollupStore.hpp"
+#include "AnomalyDetector.hpp"
+#include "AlertEngine.hpp"
+#include "HeavyHitters.hpp"
+#include "FunctionIndex.hpp"
+#include "Downsample.hpp"
+#include "TraceFilter.hpp"
+#include "TextIndex.hpp"
+#include <filesystem>
+#include <climits>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <cmath>
+#include <array>
+
+enum TraceSortKey {
+    SORT_BY_DURATION,
+    SORT_BY_RAM,
+    SORT_BY_FUNC
+};
+
+enum AggregateGroup {
+    GROUP_BY_FUNC,
+    GROUP_BY_VERSION,
+    GROUP_BY_HOUR
+};
+
+// One group of an aggregate() result. `key` is the func/version id or the
+// hour start; `name` is the resolved string for func/version groups.
+struct AggregateRow {
+    int64_t key;
+    std::string name;
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum_ram;
+    uint64_t max_ram;
+    LatencySketch sketch;
+    std::vector<uint64_t> bands;
+    DistinctRow distinct;
+
+    AggregateRow() : key(0), count(0), sum(0), min(UINT64_MAX), max(0), sum_ram(0), max_ram(0) {}
+};
+
+// Latency of one function in two versions, from compare_versions().
+struct VersionComparison {
+    uint32_t func_id;
+    std::string func;
+    LatencySketch base;
+    LatencySketch head;
+
+    VersionComparison() : func_id(0) {}
+
+    // (head p95 - base p95) / base p95
+    double p95_change() const {
+        double b = static_cast<double>(base.quantile(0.95));
+        double h = static_cast<double>(head.quantile(0.95));
+        return (h - b) / std::max(b, 1.0);
+    }
+
+    // Two-proportion z-score of the share of calls above base's p95 in
+    // head versus base. Under no regression both shares are ~5%; z > 1.96
+    // means head is slower with ~95% confidence.
+    double z_score() const {
+        double nb = static_cast<double>(base.count());
+        double nh = static_cast<double>(head.count());
+        if (nb == 0 || nh == 0) return 0.0;
+
+        uint64_t threshold = base.quantile(0.95);
+        double pb = base.count_above(threshold) / nb;
+        double ph = head.count_above(threshold) / nh;
+        double pooled = (base.count_above(threshold) + head.count_above(threshold)) / (nb + nh);
+        double se = std::sqrt(pooled * (1 - pooled) * (1 / nb + 1 / nh));
+        return se > 0 ? (ph - pb) / se : 0.0;
+    }
+};
+
+// A trace the anomaly detector flagged, with its AnomalyReason bits.
+struct FlaggedTrace {
+    ExecTrace::TraceEntry entry;
+    uint32_t reasons;
+    float z_score;
+};
+
+// Detector state of one function, from function_health().
+struct FunctionHealth {
+    std::string func;
+    FunctionBaseline baseline;
+};
+
+// Entry of top_functions(): a heavy hitter with its function name.
+struct TopFunction {
+    std::string func;
+    HeavyHitter hitter;
+};
+
+// Time x duration counts from heatmap(). Duration bin k holds values in
+// [2^(k-1), 2^k - 1] (bin 0 is exactly 0); only bins min_bin..max_bin are
+// present in each row of `counts`, one row per entry of `times`.
+struct Heatmap {
+    int64_t step;
+    RollupLevel level;
+    std::vector<int64_t> times;
+    int min_bin;
+    int max_bin;
+    std::vector<std::vector<uint64_t>> counts;
+
+    Heatmap() : step(0), level(ROLLUP_HOUR), min_bin(0), max_bin(-1) {}
+
+    static int bin_of(uint64_t value) {
+        return value == 0 ? 0 : 64 - __builtin_clzll(value);
+    }
+
+    static uint64_t bin_low(int bin) {
+        return bin == 0 ? 0 : 1ULL << (bin - 1);
+    }
+
+    static uint64_t bin_high(int bin) {
+        return bin == 0 ? 0 : (bin == 64 ? UINT64_MAX : (1ULL << bin) - 1);
+    }
+};
+
+// What aggregate() has to compute besides count/sum/min/max of duration.
+struct AggregateOptions {
+    bool ram;
+    bool percentiles;
+    bool distinct;                // hour groups only, from the hourly rollups
+    std::vector<uint64_t> bands;  // ascending duration thresholds
+
+    AggregateOptions() : ram(false), percentiles(false), distinct(false) {}
+};
+
+// A secondary BTree in its own file. `created` is set when the file did not
+// exist yet, meaning the index still has to be built from the heap. A new
+// index is built in `path`.tmp and only renamed into place by publish(), so
+// a crash mid-build leaves no file behind and the next start rebuilds it.
+// `applied_id` is the newest trace id the tree is known to hold.
+template <typename T>
+struct IndexFile {
+    std::string path;
+    DiskManager* dm;
+    BTree<T>* tree;
+    bool created;
+    int applied_id;
+
+    IndexFile(const std::string& path, int applied) : path(path), created(!std::filesystem::exists(path)) {
+        std::string file = path;
+        applied_id = applied;
+        if (created) {
+            file = path + ".tmp";
+            applied_id = 0;
+            std::error_code ec;
+            std::filesystem::remove(file, ec);
+        }
+        dm = new DiskManager(file);
+        tree = new BTree<T>(dm);
+    }
+
+    ~IndexFile() {
+        delete tree;
+        delete dm;
+    }
+
+    // Moves a freshly built index into place. On failure it stays in the
+    // temp file for this run and is rebuilt on the next start.
+    void publish() {
+        if (!created) return;
+        delete tree;
+        delete dm;
+        std::error_code ec;
+        std::filesystem::rename(path + ".tmp", path, ec);
+        if (ec) {
+            std::cout << "[ExecTraceDB] Failed to publish index " << path << ": " << ec.message() << std::endl;
+        }
+        dm = new DiskManager(ec ? path + ".tmp" : path);
+        tree = new BTree<T>(dm);
+    }
+
+    // Inserts the key of a row replayed from the heap. Rows after the last
+    // checkpoint may already be in an existing tree.
+    void replay(const T& key, int id) {
+        if (id <= applied_id) return;
+        if (!created) {
+            bool found = false;
+            tree->scan_range(key, key, [&](const T&) {
+                found = true;
+                return false;
+            });
+            if (found) return;
+        }
+        tree->insert(key);
+    }
+};
 
 class ExecTraceDB {
 private:
-    DiskManager* dm;
-    BTree<ExecTrace::TraceEntry>* trace_tree;
+    TraceHeap* heap;
+    StringDictionary* dict;
+    SegmentStore* segments;
+    IndexFile<ExecTrace::ProjectTimeKey>* time_index;
+    IndexFile<ExecTrace::FuncTimeKey>* func_index;
+    IndexFile<ExecTrace::DurationKey>* duration_index;
+    IndexFile<ExecTrace::FlaggedKey>* flagged_index;
+    ProjectStatsStore* stats;
+    RollupStore* rollups;
+    AnomalyDetector* detector;
+    AlertEngine* alerts;
+    HeavyHitters* hitters;
+    FunctionIndex* functions;
+    TextIndex* text_index;
+    std::unordered_set<std::string> text_indexed;  // segment dirs known to have one
     std::mutex db_mutex;
     int next_id;
+    std::string applied_file;
+    int64_t last_checkpoint;
+
+    // "backend/data/traces.db" -> "backend/data/traces<suffix>"
+    static std::string sibling_path(const std::string& db_file, const std::string& suffix) {
+        size_t dot = db_file.rfind('.');
+        size_t slash = db_file.find_last_of("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+            return db_file + suffix;
+        }
+        return db_file.substr(0, dot) + suffix;
+    }
+
+    void intern_strings(ExecTrace::TraceEntry& entry) {
+        entry.func_id = dict->intern(entry.project_id, DICT_FUNC, entry.func);
+        entry.version_id = dict->intern(entry.project_id, DICT_VERSION, entry.app_version);
+    }
+
+    // Fills func/app_version from dictionary ids; only needed for rendering.
+    void resolve_strings(ExecTrace::TraceEntry& entry) const {
+        if (entry.func_id == 0) return;
+
+        const std::string& func = dict->resolve(entry.project_id, DICT_FUNC, entry.func_id);
+        const std::string& version = dict->resolve(entry.project_id, DICT_VERSION, entry.version_id);
+        strncpy(entry.func, func.c_str(), sizeof(entry.func) - 1);
+        strncpy(entry.app_version, version.c_str(), sizeof(entry.app_version) - 1);
+    }
+
+    static ExecTrace::ProjectTimeKey time_key(const ExecTrace::TraceEntry& entry, const RecordId& rid) {
+        return ExecTrace::ProjectTimeKey(entry.project_id, entry.timestamp, entry.id, rid.page_id, rid.slot);
+    }
+
+    static ExecTrace::FuncTimeKey func_key(const ExecTrace::TraceEntry& entry, const RecordId& rid) {
+        return ExecTrace::FuncTimeKey(entry.project_id, entry.func_id, entry.timestamp, entry.id,
+                                      rid.page_id, rid.slot);
+    }
+
+    static ExecTrace::DurationKey duration_key(const ExecTrace::TraceEntry& entry, const RecordId& rid) {
+        return ExecTrace::DurationKey(entry.project_id, entry.duration, entry.id, entry.timestamp,
+                                      rid.page_id, rid.slot);
+    }
+
+    void index_row(const ExecTrace::TraceEntry& entry, const RecordId& rid) {
+        time_index->tree->insert(time_key(entry, rid));
+        func_index->tree->insert(func_key(entry, rid));
+        duration_index->tree->insert(duration_key(entry, rid));
+    }
+
+    // Heap row behind an index key, unless it has been deleted since.
+    bool fetch_live(const RecordId& rid, ExecTrace::TraceEntry& entry) {
+        return heap->fetch(rid, entry) && !entry.is_deleted;
+    }
+
+    // Newest trace id the segments and indexes are known to hold, or -1 if
+    // it was never recorded.
+    int read_applied() const {
+        std::ifstream in(applied_file);
+        int applied;
+        return in >> applied ? applied : -1;
+    }
+
+    bool write_applied(int applied) {
+        std::string tmp = applied_file + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::trunc);
+            if (!out.is_open()) return false;
+            out << applied << "\n";
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp, applied_file, ec);
+        return !ec;
+    }
+
+    // Records, at most once a minute of ingest time, that everything up to
+    // the newest trace is in place; a restart replays only what follows.
+    void checkpoint(int64_t now) {
+        int64_t minute = now - ((now % 60) + 60) % 60;
+        if (minute <= last_checkpoint) return;
+        last_checkpoint = minute;
+        stats->flush();
+        write_applied(next_id - 1);
+    }
+
+    ExecTrace::ProjectStats aggregate_segments(int project_id, int64_t from, int64_t to) {
+        ExecTrace::ProjectStats result;
+        result.project_id = project_id;
+        std::vector<int64_t> ts;
+        std::vector<uint64_t> durations, rams;
+
+        for (const auto& seg : segments->segments(project_id, from, to)) {
+            segments->read_column(seg, COL_DURATION, durations);
+            segments->read_column(seg, COL_RAM, rams);
+            bool whole = seg.min_ts >= from && seg.max_ts <= to;
+            if (!whole) segments->read_column(seg, COL_TIMESTAMP, ts);
+
+            size_t n = std::min(durations.size(), rams.size());
+            for (size_t i = 0; i < n; i++) {
+                if (whole || (ts[i] >= from && ts[i] <= to)) {
+                    result.add(durations[i], rams[i]);
+                }
+            }
+        }
+        return result;
+    }
+
+    // Appends the live heap rows after `from` that the segments do not hold
+    // yet: every row on first start, otherwise those a crash between the
+    // heap append and the segment append left out.
+    void replay_segments(int from) {
+        if (from >= heap->get_max_id()) return;
+
+        std::unordered_set<int> stored;
+        segments->ids_after(from, stored);
+        size_t rows = 0;
+        heap->scan_records_after(from, [&](const ExecTrace::TraceEntry& entry, const RecordId&) {
+            if (entry.is_deleted || stored.count(entry.id)) return;
+            segments->append(entry);
+            rows++;
+        });
+        if (rows > 0) {
+            std::cout << "[ExecTraceDB] Added " << rows << " traces to column segments" << std::endl;
+        }
+    }
+
+    // Runs the detector on a new trace and indexes it if it was flagged.
+    void detect_anomaly(const ExecTrace::TraceEntry& entry, const RecordId& rid, bool replay = false) {
+        AnomalyVerdict verdict = detector->observe(entry.project_id, entry.func_id, entry.duration);
+        if (verdict.reasons) {
+            ExecTrace::FlaggedKey key(entry.project_id, entry.timestamp, entry.id, rid.page_id, rid.slot,
+                                      verdict.reasons, static_cast<float>(verdict.z_score));
+            if (replay) {
+                flagged_index->replay(key, entry.id);
+            } else {
+                flagged_index->tree->insert(key);
+            }
+        }
+    }
+
+    // Brings the indexes up to the heap: a missing one is built from every
+    // row, an existing one gets the rows after the last checkpoint, which a
+    // crash between the heap append and the index insert can have skipped.
+    void catch_up_indexes() {
+        int from = std::min(std::min(time_index->applied_id, func_index->applied_id),
+                            std::min(duration_index->applied_id, flagged_index->applied_id));
+        if (from >= heap->get_max_id()) return;
+
+        std::cout << "[ExecTraceDB] Indexing traces after id " << from << std::endl;
+        size_t rows = 0;
+        heap->scan_records_after(from, [&](const ExecTrace::TraceEntry& entry, const RecordId& rid) {
+            if (entry.is_deleted) return;
+            time_index->replay(time_key(entry, rid), entry.id);
+            func_index->replay(func_key(entry, rid), entry.id);
+            duration_index->replay(duration_key(entry, rid), entry.id);
+            if (entry.id > flagged_index->applied_id) detect_anomaly(entry, rid, true);
+            rows++;
+        });
+        std::cout << "[ExecTraceDB] Indexed " << rows << " traces" << std::endl;
+    }
+
+    // Primes the detector's per-function baselines from each project's
+    // newest segment, so z-scores are meaningful right after a restart.
+    void warm_detector() {
+        std::vector<uint64_t> durations;
+        std::vector<uint32_t> func_ids;
+        for (int project_id : segments->projects()) {
+            std::vector<SegmentInfo> segs = segments->segments(project_id);
+            if (segs.empty()) continue;
+            segments->read_column(segs.back(), COL_DURATION, durations);
+            segments->read_column(segs.back(), COL_FUNC_ID, func_ids);
+            size_t n = std::min(durations.size(), func_ids.size());
+            for (size_t i = 0; i < n; i++) {
+                detector->warm(project_id, func_ids[i], durations[i]);
+            }
+        }
+    }
+
+    // Feeds rollups every segment row newer than what they have on disk.
+    // Segment rows are in id order, so only the newest segments are read.
+    void replay_rollups() {
+        size_t replayed = 0;
+        std::vector<int32_t> ids;
+        std::vector<int64_t> ts;
+        std::vector<uint64_t> durations;
+        std::vector<uint32_t> func_ids, version_ids;
+
+        for (int project_id : segments->projects()) {
+            int applied = rollups->applied_id(project_id);
+            std::vector<SegmentInfo> segs = segments->segments(project_id);
+
+            size_t start = segs.size();
+            while (start > 0) {
+                segments->read_column(segs[start - 1], COL_ID, ids);
+                if (ids.empty() || ids.back() <= applied) break;
+                start--;
+                if (ids.front() <= applied) break;
+            }
+
+            for (size_t i = start; i < segs.size(); i++) {
+                segments->read_column(segs[i], COL_ID, ids);
+                segments->read_column(segs[i], COL_TIMESTAMP, ts);
+                segments->read_column(segs[i], COL_DURATION, durations);
+                segments->read_column(segs[i], COL_FUNC_ID, func_ids);
+                segments->read_column(segs[i], COL_VERSION_ID, version_ids);
+                size_t n = std::min(std::min(ids.size(), ts.size()), std::min(durations.size(), func_ids.size()));
+                n = std::min(n, version_ids.size());
+                for (size_t r = 0; r < n; r++) {
+                    if (ids[r] <= applied) continue;
+                    rollups->add(project_id, ids[r], ts[r], func_ids[r], version_ids[r], durations[r]);
+                    replayed++;
+                }
+            }
+        }
+
+        if (replayed > 0) {
+            std::cout << "[ExecTraceDB] Replayed " << replayed << " traces into rollups" << std::endl;
+            rollups->flush();
+        }
+    }
+
+    // Merges the distinct-count sketches covering [from, to]: whole buckets
+    // of `level` first, then the uneven edges at the next finer level. A
+    // year costs about a dozen daily rows plus edge hours and minutes.
+    void merge_distinct(int project_id, RollupLevel level, int64_t from, int64_t to, DistinctRow& out) {
+        if (from > to) return;
+        auto merge = [&](int64_t, const DistinctRow& row) { out.merge(row); };
+        if (level == ROLLUP_MINUTE) {
+            rollups->scan_distinct(project_id, level, from, to, merge);
+            return;
+        }
+
+        int64_t width = RollupStore::bucket_seconds(level);
+        int64_t first = from == INT64_MIN ? INT64_MIN : from + (width - ((from % width) + width) % width) % width;
+        int64_t end = to == INT64_MAX ? INT64_MAX : (to + 1) - (((to + 1) % width) + width) % width;
+        RollupLevel finer = (RollupLevel)(level - 1);
+        if (first >= end) {
+            merge_distinct(project_id, finer, from, to, out);
+            return;
+        }
+        rollups->scan_distinct(project_id, level, first, end == INT64_MAX ? INT64_MAX : end - 1, merge);
+        if (first != INT64_MIN) merge_distinct(project_id, finer, from, first - 1, out);
+        if (end != INT64_MAX) merge_distinct(project_id, finer, end, to, out);
+    }
+
+    // Rows of one sealed segment, in (ts, id) order. They are found through
+    // the timestamp index and kept only if their id is in the segment's id
+    // column, since two segments can share an hour. Caller holds db_mutex.
+    bool text_docs(const SegmentInfo& seg, std::vector<TextDoc>& docs) {
+        std::vector<int32_t> ids;
+        if (!segments->read_column(seg, COL_ID, ids)) return false;
+        std::sort(ids.begin(), ids.end());
+
+        time_index->tree->scan_range(ExecTrace::ProjectTimeKey(seg.project_id, seg.min_ts, INT_MIN),
+                                     ExecTrace::ProjectTimeKey(seg.project_id, seg.max_ts, INT_MAX),
+                                     [&](const ExecTrace::ProjectTimeKey& key) {
+            if (std::binary_search(ids.begin(), ids.end(), key.id)) {
+                docs.push_back(TextDoc{key.timestamp, key.id, key.page_id, key.slot});
+            }
+            return true;
+        });
+        return true;
+    }
+
+    // Writes the trigram index of one segment from its rows. Called without
+    // db_mutex: it is only taken for a moment to copy each heap page, so
+    // ingest and queries are not held up by the message fetch and sort.
+    bool build_text_index(const SegmentInfo& seg, std::vector<TextDoc>& docs) {
+        std::vector<size_t> order(docs.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return docs[a].page_id < docs[b].page_id;
+        });
+
+        std::vector<std::string> messages(docs.size());
+        std::vector<bool> found(docs.size(), false);
+        char page_buffer[PAGE_SIZE];
+        ExecTrace::TraceEntry entry;
+        for (size_t i = 0; i < order.size();) {
+            int page_id = docs[order[i]].page_id;
+            bool copied;
+            {
+                std::lock_guard<std::mutex> lock(db_mutex);
+                copied = heap->copy_page(page_id, page_buffer);
+            }
+            SlottedPage page(page_buffer);
+            for (; i < order.size() && docs[order[i]].page_id == page_id; i++) {
+                const TextDoc& doc = docs[order[i]];
+                int length;
+                const char* rec = copied ? page.record(doc.slot, length) : nullptr;
+                if (rec && TraceRecord::decode(rec, length, entry) && entry.id == doc.id) {
+                    messages[order[i]] = entry.message;
+                    found[order[i]] = true;
+                }
+            }
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < docs.size(); i++) {
+            if (!found[i]) continue;
+            if (kept != i) {
+                docs[kept] = docs[i];
+                messages[kept] = std::move(messages[i]);
+            }
+            kept++;
+        }
+        docs.resize(kept);
+        messages.resize(kept);
+        return TextIndex::write(TextIndex::file_in(seg.dir), docs, messages);
+    }
+
+    // Tombstones the heap rows of a segment about to be dropped and removes
+    // their keys from every index.
+    void delete_segment_rows(const SegmentInfo& seg) {
+        std::vector<TextDoc> docs;
+        if (!text_docs(seg, docs)) return;
+
+        std::vector<RecordId> rids;
+        ExecTrace::TraceEntry entry;
+        for (const auto& doc : docs) {
+            RecordId rid(doc.page_id, doc.slot);
+            if (!heap->fetch(rid, entry) || entry.id != doc.id) continue;
+            time_index->tree->remove(time_key(entry, rid));
+            func_index->tree->remove(func_key(entry, rid));
+            duration_index->tree->remove(duration_key(entry, rid));
+            flagged_index->tree->remove(ExecTrace::FlaggedKey(entry.project_id, entry.timestamp, entry.id));
+            rids.push_back(rid);
+        }
+        heap->mark_deleted(rids);
+    }
+
+    // Empties the rollup buckets of every level that overlap [lo, hi] and
+    // refills them from the rows the segments still hold there.
+    void rebuild_rollups(int project_id, int64_t lo, int64_t hi) {
+        auto floor_to = [](int64_t ts, int64_t width) { return ts - ((ts % width) + width) % width; };
+        for (int l = 0; l < ROLLUP_LEVELS; l++) {
+            int64_t width = RollupStore::bucket_seconds((RollupLevel)l);
+            rollups->clear(project_id, (RollupLevel)l, floor_to(lo, width), floor_to(hi, width));
+        }
+
+        int64_t day = RollupStore::bucket_seconds(ROLLUP_DAY);
+        int64_t from = floor_to(lo, day);
+        int64_t to = floor_to(hi, day) + day - 1;
+        std::vector<int64_t> ts;
+        std::vector<uint64_t> durations;
+        std::vector<uint32_t> func_ids, version_ids;
+        for (const auto& seg : segments->segments(project_id, from, to)) {
+            segments->read_column(seg, COL_TIMESTAMP, ts);
+            segments->read_column(seg, COL_DURATION, durations);
+            segments->read_column(seg, COL_FUNC_ID, func_ids);
+            segments->read_column(seg, COL_VERSION_ID, version_ids);
+            size_t n = std::min(std::min(ts.size(), durations.size()), std::min(func_ids.size(), version_ids.size()));
+            for (size_t i = 0; i < n; i++) {
+                for (int l = 0; l < ROLLUP_LEVELS; l++) {
+                    int64_t width = RollupStore::bucket_seconds((RollupLevel)l);
+                    int64_t bucket = floor_to(ts[i], width);
+                    if (bucket < floor_to(lo, width) || bucket > floor_to(hi, width)) continue;
+                    rollups->restore(project_id, (RollupLevel)l, ts[i], func_ids[i], version_ids[i], durations[i]);
+                }
+            }
+        }
+        rollups->flush();
+    }
+
+    // Seeds the heavy-hitter summaries and the autocomplete call counts from
+    // the daily rollups, which hold exact per-function call counts and total
+    // time. Names come from the dictionary, so a project whose segments
+    // have all been dropped still autocompletes.
+    void warm_function_counts() {
+        std::vector<std::string> names;
+        for (int project_id : dict->projects(DICT_FUNC)) {
+            names.clear();
+            size_t n = dict->size(project_id, DICT_FUNC);
+            for (uint32_t id = 1; id <= n; id++) names.push_back(dict->resolve(project_id, DICT_FUNC, id));
+            functions->load(project_id, names);
+
+            rollups->scan(project_id, ROLLUP_DAY, INT64_MIN, INT64_MAX, [&](int64_t, uint32_t func, const RollupRow& row) {
+                hitters->add(project_id, func, row.count, row.sum);
+                functions->add_calls(project_id, func, row.count);
+            });
+        }
+    }
+
+    // Visits live traces of one project (through the timestamp index) or of
+    // every project (project_id < 0, through the heap) inside [from, to].
+    void for_each_trace(int project_id, int64_t from, int64_t to,
+                        const std::function<void(ExecTrace::TraceEntry&)>& visit) {
+        ExecTrace::TraceEntry entry;
+        if (project_id >= 0) {
+            time_index->tree->scan_range(ExecTrace::ProjectTimeKey(project_id, from, INT_MIN),
+                                         ExecTrace::ProjectTimeKey(project_id, to, INT_MAX),
+                                         [&](const ExecTrace::ProjectTimeKey& key) {
+                if (heap->fetch(RecordId(key.page_id, key.slot), entry) && entry.is_valid()) visit(entry);
+                return true;
+            });
+            return;
+        }
+
+        heap->scan([&](const ExecTrace::TraceEntry& row) {
+            if (!row.is_valid() || row.timestamp < from || row.timestamp > to) return;
+            entry = row;
+            visit(entry);
+        });
+    }
+
+    // for_each_trace restricted to rows matching `filter`. The filter's ts
+    // bounds narrow the window, and when it pins the function to a few ids
+    // the function index is read for just those instead.
+    void for_each_match(int project_id, int64_t from, int64_t to, const TraceFilter* filter,
+                        const std::function<void(ExecTrace::TraceEntry&)>& visit) {
+        if (!filter || filter->empty()) {
+            for_each_trace(project_id, from, to, visit);
+            return;
+        }
+
+        filter->time_bounds(from, to);
+        if (from > to) return;
+
+        std::vector<uint32_t> func_ids;
+        if (project_id >= 0 && filter->function_candidates(project_id, *dict, func_ids) && func_ids.size() <= 64) {
+            ExecTrace::TraceEntry entry;
+            for (uint32_t func_id : func_ids) {
+                func_index->tree->scan_range(ExecTrace::FuncTimeKey(project_id, func_id, from, INT_MIN),
+                                             ExecTrace::FuncTimeKey(project_id, func_id, to, INT_MAX),
+                                             [&](const ExecTrace::FuncTimeKey& key) {
+                    if (heap->fetch(RecordId(key.page_id, key.slot), entry) && entry.is_valid() &&
+                        filter->matches(entry, *dict)) {
+                        visit(entry);
+                    }
+                    return true;
+                });
+            }
+            return;
+        }
+
+        for_each_trace(project_id, from, to, [&](ExecTrace::TraceEntry& entry) {
+            if (filter->matches(entry, *dict)) visit(entry);
+        });
+    }
+
+    // Keeps the best `limit` rows in a bounded heap whose top is the worst
+    // row kept so far; `before(a, b)` is true when a ranks ahead of b.
+    template <typename Before>
+    std::vector<ExecTrace::TraceEntry> select_top(int project_id, int64_t from, int64_t to,
+                                                  size_t limit, bool resolve_first, Before before,
+                                                  const TraceFilter* filter = nullptr) {
+        std::vector<ExecTrace::TraceEntry> top;
+        if (limit == 0) return top;
+        top.reserve(std::min<size_t>(limit, 1024));
+
+        for_each_match(project_id, from, to, filter, [&](ExecTrace::TraceEntry& entry) {
+            if (resolve_first) resolve_strings(entry);
+            if (top.size() < limit) {
+                top.push_back(entry);
+                std::push_heap(top.begin(), top.end(), before);
+            } else if (before(entry, top.front())) {
+                std::pop_heap(top.begin(), top.end(), before);
+                top.back() = entry;
+                std::push_heap(top.begin(), top.end(), before);
+            }
+        });
+
+        std::sort_heap(top.begin(), top.end(), before);
+        if (!resolve_first) {
+            for (auto& e : top) resolve_strings(e);
+        }
+        return top;
+    }
 
 public:
-    ExecTraceDB(const std::string& db_file) : next_id(1) {
-        dm = new DiskManager(db_file);
-        trace_tree = new BTree<ExecTrace::TraceEntry>(dm);
-        std::cout << "[ExecTraceDB] Initialized traces database" << std::endl;
+    // `thresholds` must be known up front: a missing flagged index is
+    // rebuilt by replaying the heap through the detector.
+    ExecTraceDB(const std::string& db_file, const std::vector<ProjectThresholds>& thresholds = {})
+        : next_id(1), applied_file(sibling_path(db_file, "_applied")), last_checkpoint(0) {
+        dict = new StringDictionary(sibling_path(db_file, ".dict"));
+
+        if (TraceHeap::is_legacy_file(db_file)) {
+            std::cout << "[ExecTraceDB] Legacy traces file detected, converting to slotted pages" << std::endl;
+            bool converted = TraceHeap::convert_legacy_file(db_file, [this](ExecTrace::TraceEntry& entry) {
+                intern_strings(entry);
+            });
+            if (!converted) {
+                delete dict;
+                throw std::runtime_error("Failed to convert legacy traces file " + db_file);
+            }
+        }
+
+        heap = new TraceHeap(db_file);
+        next_id = heap->get_max_id() + 1;
+        // Indexes of stores from before the checkpoint file are taken as complete
+        int recorded = read_applied();
+        int applied = recorded < 0 ? next_id - 1 : recorded;
+
+        segments = new SegmentStore(sibling_path(db_file, "_segments"));
+        // Without a checkpoint, the segments hold every row up to their
+        // newest one (none on first start); a store that recorded its
+        // backfill and has since dropped every segment holds them all
+        int segments_from = applied;
+        if (recorded < 0) {
+            segments_from = segments->max_id();
+            if (segments_from == 0 && segments->backfilled()) segments_from = next_id - 1;
+        }
+        replay_segments(segments_from);
+        segments->seal_expired(time(nullptr));
+
+        time_index = new IndexFile<ExecTrace::ProjectTimeKey>(sibling_path(db_file, "_ts.idx"), applied);
+        func_index = new IndexFile<ExecTrace::FuncTimeKey>(sibling_path(db_file, "_func.idx"), applied);
+        duration_index = new IndexFile<ExecTrace::DurationKey>(sibling_path(db_file, "_dur.idx"), applied);
+        flagged_index = new IndexFile<ExecTrace::FlaggedKey>(sibling_path(db_file, "_flagged.idx"), applied);
+        detector = new AnomalyDetector();
+        for (const auto& t : thresholds) detector->set_thresholds(t.project_id, t.fast, t.normal);
+        bool replays_detector = flagged_index->created;
+        catch_up_indexes();
+        time_index->publish();
+        func_index->publish();
+        duration_index->publish();
+        flagged_index->publish();
+        if (!replays_detector) warm_detector();
+
+        // Stats pages are only written at a checkpoint, so after a crash
+        // they are rebuilt from the segments, which hold every live row
+        std::string stats_file = sibling_path(db_file, "_stats.db");
+        bool stats_missing = !std::filesystem::exists(stats_file);
+        stats = new ProjectStatsStore(stats_file);
+        if ((stats_missing || recorded != next_id - 1) && next_id > 1) {
+            std::cout << "[ExecTraceDB] Building project stats from the segments" << std::endl;
+            stats->clear();
+            for (int project_id : segments->projects()) {
+                ExecTrace::ProjectStats s = aggregate_segments(project_id, INT64_MIN, INT64_MAX);
+                if (s.count > 0) stats->set(s);
+            }
+            stats->flush();
+        }
+
+        rollups = new RollupStore(sibling_path(db_file, "_rollups"));
+        replay_rollups();
+
+        hitters = new HeavyHitters();
+        functions = new FunctionIndex();
+        warm_function_counts();
+
+        text_index = new TextIndex(sibling_path(db_file, "_text.projects"));
+
+        alerts = new AlertEngine(sibling_path(db_file, "_alerts.rules"));
+
+        write_applied(next_id - 1);
+        std::cout << "[ExecTraceDB] Initialized traces database (next id " << next_id << ")" << std::endl;
     }
 
     ~ExecTraceDB() {
-        delete trace_tree;
-        delete dm;
+        stats->flush();
+        write_applied(next_id - 1);
+        delete text_index;
+        delete functions;
+        delete hitters;
+        delete alerts;
+        delete detector;
+        delete flagged_index;
+        delete rollups;
+        delete stats;
+        delete duration_index;
+        delete func_index;
+        delete time_index;
+        delete segments;
+        delete heap;
+        delete dict;
     }
 
-    int log_event(int project_id, const char* func, const char* msg, 
+    int log_event(int project_id, const char* func, const char* msg,
                   const char* app_version, uint64_t duration, uint64_t ram) {
         std::lock_guard<std::mutex> lock(db_mutex);
-        
+
         int entry_id = next_id++;
         ExecTrace::TraceEntry entry(entry_id, project_id, func, msg, app_version, duration, ram);
-        trace_tree->insert(entry);
-        
-        std::cout << "[TraceDB] Logged event " << entry_id << " for project " << project_id 
+        intern_strings(entry);
+        RecordId rid = heap->append(entry);
+        index_row(entry, rid);
+        detect_anomaly(entry, rid);
+        segments->seal_expired(entry.timestamp);
+        segments->append(entry);
+        stats->add(project_id, duration, ram);
+        rollups->add(project_id, entry_id, entry.timestamp, entry.func_id, entry.version_id, duration);
+        rollups->checkpoint(entry.timestamp);
+        alerts->observe(entry);
+        hitters->add(project_id, entry.func_id, 1, duration);
+        functions->add_function(project_id, entry.func_id, entry.func);
+        functions->add_calls(project_id, entry.func_id, 1);
+        checkpoint(entry.timestamp);
+
+        std::cout << "[TraceDB] Logged event " << entry_id << " for project " << project_id
                   << ": " << func << " (" << duration << "ms)" << std::endl;
-        
+
         return entry_id;
     }
 
     std::vector<ExecTrace::TraceEntry> search(int entry_id) {
         std::lock_guard<std::mutex> lock(db_mutex);
-        ExecTrace::TraceEntry search_key(entry_id, 0, "", "", "", 0, 0);
-        return trace_tree->search(search_key);
+        std::vector<ExecTrace::TraceEntry> results;
+        ExecTrace::TraceEntry entry;
+        if (heap->fetch(entry_id, entry) && !entry.is_deleted) {
+            resolve_strings(entry);
+            results.push_back(entry);
+        }
+        return results;
     }
 
     std::vector<ExecTrace::TraceEntry> search_by_project(int project_id) {
+        return search_by_project(project_id, INT64_MIN, INT64_MAX);
+    }
+
+    // Walks the (project_id, timestamp, id) index, so the cost is
+    // proportional to the number of traces in the window.
+    std::vector<ExecTrace::TraceEntry> search_by_project(int project_id, int64_t from, int64_t to) {
         std::lock_guard<std::mutex> lock(db_mutex);
         std::cout << "[ExecTraceDB] Searching traces for project " << project_id << std::endl;
 
-        auto all_traces = trace_tree->get_all_values();
-        std::vector<ExecTrace::TraceEntry> filtered;
-        
-        for (const auto& entry : all_traces) {
-            if (entry.project_id == project_id) {
-                filtered.push_back(entry);
+        std::vector<ExecTrace::TraceEntry> results;
+        ExecTrace::ProjectTimeKey lo(project_id, from, INT_MIN);
+        ExecTrace::ProjectTimeKey hi(project_id, to, INT_MAX);
+        ExecTrace::TraceEntry entry;
+
+        time_index->tree->scan_range(lo, hi, [&](const ExecTrace::ProjectTimeKey& key) {
+            if (fetch_live(RecordId(key.page_id, key.slot), entry)) {
+                resolve_strings(entry);
+                results.push_back(entry);
+            }
+            return true;
+        });
+
+        std::cout << "[ExecTraceDB] Found " << results.size() << " traces for project " << project_id << std::endl;
+        return results;
+    }
+
+    // One page of a project's traces in (timestamp, id) order, resuming
+    // strictly after `after` when given. Reads at most limit + 1 index keys,
+    // so the cost of a page does not depend on how deep it is.
+    std::vector<ExecTrace::TraceEntry> page_by_project(int project_id, size_t limit,
+                                                       const ExecTrace::TraceCursor* after, bool& has_more,
+                                                       int64_t from = INT64_MIN, int64_t to = INT64_MAX) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+
+        std::vector<ExecTrace::TraceEntry> results;
+        has_more = false;
+
+        ExecTrace::ProjectTimeKey lo(project_id, from, INT_MIN);
+        if (after && after->timestamp >= from) {
+            lo = ExecTrace::ProjectTimeKey(project_id, after->timestamp, after->id);
+        }
+        ExecTrace::ProjectTimeKey hi(project_id, to, INT_MAX);
+        ExecTrace::TraceEntry entry;
+
+        time_index->tree->scan_range(lo, hi, [&](const ExecTrace::ProjectTimeKey& key) {
+            if (after && key.timestamp == after->timestamp && key.id == after->id) return true;
+            if (results.size() == limit) {
+                has_more = true;
+                return false;
+            }
+            if (fetch_live(RecordId(key.page_id, key.slot), entry)) {
+                resolve_strings(entry);
+                results.push_back(entry);
             }
+            return true;
+        });
+
+        return results;
+    }
+
+    // History of one function via the (project_id, func_id, timestamp) index.
+    std::vector<ExecTrace::TraceEntry> search_by_function(int project_id, const std::string& func,
+                                                          int64_t from = INT64_MIN, int64_t to = INT64_MAX) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+
+        std::vector<ExecTrace::TraceEntry> results;
+        uint32_t func_id;
+        if (!dict->lookup(project_id, DICT_FUNC, func, func_id)) {
+            return results;
+        }
+
+        ExecTrace::FuncTimeKey lo(project_id, func_id, from, INT_MIN);
+        ExecTrace::FuncTimeKey hi(project_id, func_id, to, INT_MAX);
+        ExecTrace::TraceEntry entry;
+
+        func_index->tree->scan_range(lo, hi, [&](const ExecTrace::FuncTimeKey& key) {
+            if (fetch_live(RecordId(key.page_id, key.slot), entry)) {
+                resolve_strings(entry);
+                results.push_back(entry);
+            }
+            return true;
+        });
+
+        std::cout << "[ExecTraceDB] Found " << results.size() << " traces for " << func
+                  << " in project " << project_id << std::endl;
+        return results;
+    }
+
+    // Slowest (or fastest) `limit` traces of a project. Reads the duration
+    // index from the front, so no sort is needed. With a time window, a
+    // small window is read through the timestamp index and selected in
+    // memory; a large one is filtered on the duration index keys.
+    std::vector<ExecTrace::TraceEntry> top_by_duration(int project_id, size_t limit, bool slowest = true,
+                                                       int64_t from = INT64_MIN, int64_t to = INT64_MAX) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+
+        std::vector<ExecTrace::TraceEntry> results;
+        ExecTrace::TraceEntry entry;
+        if (limit == 0) return results;
+
+        if (from != INT64_MIN || to != INT64_MAX) {
+            const size_t window_probe = std::max<size_t>(4096, std::min(limit, SIZE_MAX / 16) * 16);
+            std::vector<ExecTrace::ProjectTimeKey> window;
+            bool truncated = false;
+
+            time_index->tree->scan_range(ExecTrace::ProjectTimeKey(project_id, from, INT_MIN),
+                                         ExecTrace::ProjectTimeKey(project_id, to, INT_MAX),
+                                         [&](const ExecTrace::ProjectTimeKey& key) {
+                if (window.size() >= window_probe) {
+                    truncated = true;
+                    return false;
+                }
+                window.push_back(key);
+                return true;
+            });
+
+            if (!truncated) {
+                for (const auto& key : window) {
+                    if (fetch_live(RecordId(key.page_id, key.slot), entry)) {
+                        results.push_back(entry);
+                    }
+                }
+
+                auto order = [slowest](const ExecTrace::TraceEntry& a, const ExecTrace::TraceEntry& b) {
+                    if (a.duration != b.duration) return slowest ? a.duration > b.duration : a.duration < b.duration;
+                    return a.id < b.id;
+                };
+                size_t n = std::min(limit, results.size());
+                std::partial_sort(results.begin(), results.begin() + n, results.end(), order);
+                results.resize(n);
+                for (auto& e : results) resolve_strings(e);
+                return results;
+            }
+        }
+
+        auto visit = [&](const ExecTrace::DurationKey& key) {
+            if (key.timestamp < from || key.timestamp > to) return true;
+            if (fetch_live(RecordId(key.page_id, key.slot), entry)) {
+                resolve_strings(entry);
+                results.push_back(entry);
+            }
+            return results.size() < limit;
+        };
+
+        ExecTrace::DurationKey lo(project_id, UINT64_MAX, INT_MIN);
+        ExecTrace::DurationKey hi(project_id, 0, INT_MAX);
+        if (slowest) {
+            duration_index->tree->scan_range(lo, hi, visit);
+        } else {
+            duration_index->tree->scan_range_reverse(lo, hi, visit);
+        }
+        return results;
+    }
+
+    // Top `limit` traces by an arbitrary sort key without materializing the
+    // full result; project_id < 0 means every project. The comparator is
+    // chosen once here, not per comparison. Only rows matching `filter`
+    // are considered.
+    std::vector<ExecTrace::TraceEntry> top_k(int project_id, TraceSortKey key, bool descending, size_t limit,
+                                             int64_t from = INT64_MIN, int64_t to = INT64_MAX,
+                                             const TraceFilter* filter = nullptr) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        typedef const ExecTrace::TraceEntry& Row;
+
+        switch (key) {
+            case SORT_BY_RAM:
+                if (descending) {
+                    return select_top(project_id, from, to, limit, false, [](Row a, Row b) {
+                        return a.ram_usage != b.ram_usage ? a.ram_usage > b.ram_usage : a.id < b.id;
+                    }, filter);
+                }
+                return select_top(project_id, from, to, limit, false, [](Row a, Row b) {
+                    return a.ram_usage != b.ram_usage ? a.ram_usage < b.ram_usage : a.id < b.id;
+                }, filter);
+
+            case SORT_BY_FUNC:
+                if (descending) {
+                    return select_top(project_id, from, to, limit, true, [](Row a, Row b) {
+                        int c = strcmp(a.func, b.func);
+                        return c != 0 ? c > 0 : a.id < b.id;
+                    }, filter);
+                }
+                return select_top(project_id, from, to, limit, true, [](Row a, Row b) {
+                    int c = strcmp(a.func, b.func);
+                    return c != 0 ? c < 0 : a.id < b.id;
+                }, filter);
+
+            case SORT_BY_DURATION:
+            default:
+                if (descending) {
+                    return select_top(project_id, from, to, limit, false, [](Row a, Row b) {
+                        return a.duration != b.duration ? a.duration > b.duration : a.id < b.id;
+                    }, filter);
+                }
+                return select_top(project_id, from, to, limit, false, [](Row a, Row b) {
+                    return a.duration != b.duration ? a.duration < b.duration : a.id < b.id;
+                }, filter);
         }
-        
-        std::cout << "[ExecTraceDB] Found " << filtered.size() << " traces for project " << project_id << std::endl;
-        return filtered;
     }
 
     std::vector<ExecTrace::TraceEntry> get_all_traces() {
         std::lock_guard<std::mutex> lock(db_mutex);
         std::cout << "[ExecTraceDB] get_all_traces called" << std::endl;
 
-        auto all_entries = trace_tree->get_all_values();
-        std::cout << "[ExecTraceDB] Found " << all_entries.size() << " total entries" << std::endl;
-
+        size_t total = 0;
         std::vector<ExecTrace::TraceEntry> valid;
-        for (const auto& entry : all_entries) {
+        heap->scan([&](const ExecTrace::TraceEntry& entry) {
+            total++;
             if (entry.is_valid()) {
                 valid.push_back(entry);
+                resolve_strings(valid.back());
             }
-        }
-        
-        std::cout << "[ExecTraceDB] Filtered to " << valid.size() << " valid entries" << std::endl;
+        });
+
+        std::cout << "[ExecTraceDB] Filtered " << total << " entries to " << valid.size() << " valid entries" << std::endl;
         return valid;
     }
+
+    bool lookup_func_id(int project_id, const std::string& func, uint32_t& out_id) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        return dict->lookup(project_id, DICT_FUNC, func, out_id);
+    }
+
+    bool lookup_version_id(int project_id, const std::string& version, uint32_t& out_id) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        return dict->lookup(project_id, DICT_VERSION, version, out_id);
+    }
+
+    std::string func_name(int project_id, uint32_t func_id) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        return dict->resolve(project_id, DICT_FUNC, func_id);
+    }
+
+    std::string version_name(int project_id, uint32_t version_id) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        return dict->resolve(project_id, DICT_VERSION, version_id);
+    }
+
+    // Single-pass hash aggregation over the segment columns in [from, to].
+    // Only the columns the grouping and options need are read. With
+    // thresholds t0 < t1 < ..., bands[i] counts durations in [t(i-1), t(i)).
+    std::vector<AggregateRow> aggregate(int project_id, AggregateGroup group_by,
+                                        const AggregateOptions& options,
+                                        int64_t from = INT64_MIN, int64_t to = INT64_MAX) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+
+        std::vector<AggregateRow> groups;
+        std::unordered_map<int64_t, size_t> slots;
+        std::vector<int64_t> ts;
+        std::vector<uint64_t> durations, rams;
+        std::vector<uint32_t> ids;
+
+        for (const auto& seg : segments->segments(project_id, from, to)) {
+            bool whole = seg.min_ts >= from && seg.max_ts <= to;
+            segments->read_column(seg, COL_DURATION, durations);
+            if (!whole || group_by == GROUP_BY_HOUR) segments->read_column(seg, COL_TIMESTAMP, ts);
+            if (options.ram) segments->read_column(seg, COL_RAM, rams);
+            if (group_by == GROUP_BY_FUNC) segments->read_column(seg, COL_FUNC_ID, ids);
+            if (group_by == GROUP_BY_VERSION) segments->read_column(seg, COL_VERSION_ID, ids);
+
+            size_t n = durations.size();
+            if (!whole || group_by == GROUP_BY_HOUR) n = std::min(n, ts.size());
+            if (options.ram) n = std::min(n, rams.size());
+            if (group_by != GROUP_BY_HOUR) n = std::min(n, ids.size());
+
+            // Rows of one segment come in runs of the same key, so remember
+            // the last group before going to the hash table
+            int64_t last_key = 0;
+            AggregateRow* row = nullptr;
+            for (size_t i = 0; i < n; i++) {
+                if (!whole && (ts[i] < from || ts[i] > to)) continue;
+
+                int64_t key = group_by == GROUP_BY_HOUR ? ts[i] - ((ts[i] % 3600) + 3600) % 3600 : ids[i];
+                if (!row || key != last_key) {
+                    auto slot = slots.find(key);
+                    if (slot == slots.end()) {
+                        slot = slots.emplace(key, groups.size()).first;
+                        groups.emplace_back();
+                        groups.back().key = key;
+                        groups.back().bands.assign(options.bands.empty() ? 0 : options.bands.size() + 1, 0);
+                    }
+                    row = &groups[slot->second];
+                    last_key = key;
+                }
+
+                uint64_t d = durations[i];
+                row->count++;
+                row->sum += d;
+                row->min = std::min(row->min, d);
+                row->max = std::max(row->max, d);
+                if (options.ram) {
+                    row->sum_ram += rams[i];
+                    row->max_ram = std::max(row->max_ram, rams[i]);
+                }
+                if (options.percentiles) row->sketch.add(d);
+                if (!options.bands.empty()) {
+                    size_t b = std::upper_bound(options.bands.begin(), options.bands.end(), d) - options.bands.begin();
+                    row->bands[b]++;
+                }
+            }
+        }
+
+        if (options.distinct && group_by == GROUP_BY_HOUR) {
+            rollups->scan_distinct(project_id, ROLLUP_HOUR, from, to, [&](int64_t hour, const DistinctRow& row) {
+                auto slot = slots.find(hour);
+                if (slot != slots.end()) groups[slot->second].distinct = row;
+            });
+        }
+        if (group_by != GROUP_BY_HOUR) {
+            DictKind kind = group_by == GROUP_BY_FUNC ? DICT_FUNC : DICT_VERSION;
+            for (auto& g : groups) g.name = dict->resolve(project_id, kind, static_cast<uint32_t>(g.key));
+        }
+        std::sort(groups.begin(), groups.end(), [](const AggregateRow& a, const AggregateRow& b) {
+            return a.key < b.key;
+        });
+        return groups;
+    }
+
+    // Duration (or RAM, when `ram` is set) of every trace in [from, to],
+    // reduced to at most `points` points with LTTB. Streams the segment
+    // columns in time order; `total` receives the number of source traces.
+    std::vector<SeriesPoint> downsample(int project_id, bool ram, size_t points, size_t& total,
+                                        int64_t from = INT64_MIN, int64_t to = INT64_MAX,
+                                        const uint32_t* func_id = nullptr) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+
+        std::vector<SegmentInfo> segs = segments->segments(project_id, from, to);
+        std::vector<int64_t> ts;
+        std::vector<uint64_t> values;
+        std::vector<uint32_t> func_ids;
+
+        // LTTB buckets by count, so count the matching rows first; whole
+        // segments without a function filter are known from the catalog
+        total = 0;
+        for (const auto& seg : segs) {
+            bool whole = seg.min_ts >= from && seg.max_ts <= to;
+            if (whole && !func_id) {
+                total += seg.rows;
+                continue;
+            }
+            segments->read_column(seg, COL_TIMESTAMP, ts);
+            if (func_id) segments->read_column(seg, COL_FUNC_ID, func_ids);
+            for (size_t i = 0; i < ts.size(); i++) {
+                if (ts[i] < from || ts[i] > to) continue;
+                if (func_id && (i >= func_ids.size() || func_ids[i] != *func_id)) continue;
+                total++;
+            }
+        }
+
+        LttbSampler sampler(total, points);
+        size_t pushed = 0;
+        for (const auto& seg : segs) {
+            segments->read_column(seg, COL_TIMESTAMP, ts);
+            segments->read_column(seg, ram ? COL_RAM : COL_DURATION, values);
+            if (func_id) segments->read_column(seg, COL_FUNC_ID, func_ids);
+            size_t n = std::min(ts.size(), values.size());
+            if (func_id) n = std::min(n, func_ids.size());
+            for (size_t i = 0; i < n && pushed < total; i++) {
+                if (ts[i] < from || ts[i] > to) continue;
+                if (func_id && func_ids[i] != *func_id) continue;
+                sampler.push(ts[i], values[i]);
+                pushed++;
+            }
+        }
+        return sampler.take();
+    }
+
+    // Estimated distinct functions and versions of a project in [from, to],
+    // to within a minute at the window edges.
+    DistinctRow distinct_counts(int project_id, int64_t from = INT64_MIN, int64_t to = INT64_MAX) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        DistinctRow result;
+        merge_distinct(project_id, ROLLUP_DAY, from, to, result);
+        return result;
+    }
+
+    // Thresholds the detector applies at ingest; projects default to 100/500.
+    void set_thresholds(int project_id, int fast_threshold, int normal_threshold) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        detector->set_thresholds(project_id, fast_threshold, normal_threshold);
+    }
+
+    // Flagged traces of a project inside [from, to], newest first.
+    std::vector<FlaggedTrace> flagged_events(int project_id, size_t limit,
+                                             int64_t from = INT64_MIN, int64_t to = INT64_MAX) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+
+        std::vector<FlaggedTrace> results;
+        ExecTrace::FlaggedKey lo(project_id, from, INT_MIN);
+        ExecTrace::FlaggedKey hi(project_id, to, INT_MAX);
+        flagged_index->tree->scan_range_reverse(lo, hi, [&](const ExecTrace::FlaggedKey& key) {
+            if (results.size() == limit) return false;
+            FlaggedTrace flagged;
+            if (fetch_live(RecordId(key.page_id, key.slot), flagged.entry)) {
+                resolve_strings(flagged.entry);
+                flagged.reasons = key.reasons;
+                flagged.z_score = key.z_score;
+                results.push_back(flagged);
+            }
+            return true;
+        });
+        return results;
+    }
+
+    // In-memory detector state per function, most slow calls first.
+    std::vector<FunctionHealth> function_health(int project_id) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+
+        std::vector<FunctionHealth> result;
+        for (const auto& f : detector->functions(project_id)) {
+            FunctionHealth health;
+            health.func = dict->resolve(project_id, DICT_FUNC, f.first);
+            health.baseline = f.second;
+            result.push_back(health);
+        }
+        std::sort(result.begin(), result.end(), [](const FunctionHealth& a, const FunctionHealth& b) {
+            if (a.baseline.slow_calls != b.baseline.slow_calls) return a.baseline.slow_calls > b.baseline.slow_calls;
+            return a.func < b.func;
+        });
+        return result;
+    }
+
+    // Approximate k most called (or most time consuming) functions, served
+    // from the in-memory Space-Saving summaries.
+    std::vector<TopFunction> top_functions(int project_id, HitterMetric metric, size_t k) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+
+        std::vector<TopFunction> result;
+        for (const auto& h : hitters->top(project_id, metric, k)) {
+            TopFunction top;
+            top.func = dict->resolve(project_id, DICT_FUNC, h.key);
+            top.hitter = h;
+            result.push_back(top);
+        }
+        return result;
+    }
+
+    // Up to `limit` functions whose name starts with `prefix` (ignoring
+    // case), most called first.
+    std::vector<FunctionSuggestion> complete_functions(int project_id, const std::string& prefix, size_t limit) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+
+        std::vector<FunctionSuggestion> result;
+        for (const auto& match : functions->complete(project_id, prefix, limit)) {
+            result.push_back(FunctionSuggestion{dict->resolve(project_id, DICT_FUNC, match.first), match.second});
+        }
+        return result;
+    }
+
+    // Returns the new rule id, or 0 with `error` describing the problem.
+    int add_alert_rule(int project_id, const std::string& expression, const std::string& webhook,
+                       std::string& error) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        AlertRule rule;
+        rule.project_id = project_id;
+        rule.expression = expression;
+        rule.webhook = webhook;
+        return alerts->add_rule(rule, error);
+    }
+
+    bool remove_alert_rule(int project_id, int rule_id) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        return alerts->remove_rule(project_id, rule_id);
+    }
+
+    size_t remove_project_alerts(int project_id) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        return alerts->remove_project(project_id);
+    }
+
+    // A project's rules and whether each is currently firing.
+    std::vector<std::pair<AlertRule, bool>> alert_rules(int project_id) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        return alerts->list(project_id);
+    }
+
+    // Rules that started firing or resolved since the last call.
+    std::vector<AlertEvent> evaluate_alerts(int64_t now) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        return alerts->evaluate(now);
+    }
+
+    // Running aggregates maintained at ingest; no trace data is read.
+    ExecTrace::ProjectStats project_stats(int project_id) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        return stats->get(project_id);
+    }
+
+    // Column-only aggregate: reads duration and ram, never the row heap.
+    ExecTrace::ProjectStats compute_stats(int project_id, int64_t from = INT64_MIN,
+                                          int64_t to = INT64_MAX) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        return aggregate_segments(project_id, from, to);
+    }
+
+    // Latency distribution over [from, to] by merging per-segment sketches.
+    // Segments only partly inside the window are re-read from their
+    // columns. A null func_id means every function of the project; with no
+    // window that is answered from the running project sketch.
+    LatencySketch latency_sketch(int project_id, int64_t from = INT64_MIN, int64_t to = INT64_MAX,
+                                 const uint32_t* func_id = nullptr) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        if (!func_id && from == INT64_MIN && to == INT64_MAX) return segments->project_sketch(project_id);
+
+        LatencySketch result;
+        std::vector<int64_t> ts;
+        std::vector<uint64_t> durations;
+        std::vector<uint32_t> func_ids;
+
+        for (const auto& seg : segments->segments(project_id, from, to)) {
+            if (seg.min_ts >= from && seg.max_ts <= to) {
+                const SketchSet& set = segments->sketches(seg);
+                if (!func_id) {
+                    result.merge(set.all);
+                } else {
+                    auto f = set.funcs.find(*func_id);
+                    if (f != set.funcs.end()) result.merge(f->second);
+                }
+                continue;
+            }
+
+            segments->read_column(seg, COL_TIMESTAMP, ts);
+            segments->read_column(seg, COL_DURATION, durations);
+            segments->read_column(seg, COL_FUNC_ID, func_ids);
+            size_t n = std::min(ts.size(), std::min(durations.size(), func_ids.size()));
+            for (size_t i = 0; i < n; i++) {
+                if (ts[i] >= from && ts[i] <= to && (!func_id || func_ids[i] == *func_id)) {
+                    result.add(durations[i]);
+                }
+            }
+        }
+        return result;
+    }
+
+    // Duration heatmap over [from, to] in columns of `step` seconds, built
+    // from the sketches in the coarsest rollup level that divides `step`,
+    // so a week at hourly steps reads 7 partition files regardless of how
+    // many traces they summarize. A null func_id covers the whole project.
+    Heatmap heatmap(int project_id, int64_t from, int64_t to, int64_t step, const uint32_t* func_id = nullptr) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+
+        Heatmap map;
+        map.step = step;
+        map.level = ROLLUP_MINUTE;
+        for (int l = ROLLUP_DAY; l > ROLLUP_MINUTE; l--) {
+            if (step % RollupStore::bucket_seconds((RollupLevel)l) == 0) {
+                map.level = (RollupLevel)l;
+                break;
+            }
+        }
+
+        int64_t first = from - ((from % step) + step) % step;
+        for (int64_t t = first; t <= to; t += step) map.times.push_back(t);
+        if (map.times.empty()) return map;
+
+        std::vector<std::array<uint64_t, 65>> columns(map.times.size());
+        for (auto& c : columns) c.fill(0);
+        int min_bin = 64, max_bin = -1;
+
+        rollups->scan(project_id, map.level, from, to, [&](int64_t bucket, uint32_t func, const RollupRow& row) {
+            if (func_id && func != *func_id) return;
+            int64_t column = (bucket - first) / step;
+            if (column < 0 || column >= static_cast<int64_t>(columns.size())) return;
+            for (const auto& b : row.sketch.bucket_counts()) {
+                int bin = Heatmap::bin_of(LatencySketch::bucket_low(b.first));
+                columns[column][bin] += b.second;
+                min_bin = std::min(min_bin, bin);
+                max_bin = std::max(max_bin, bin);
+            }
+        });
+
+        map.min_bin = max_bin < 0 ? 0 : min_bin;
+        map.max_bin = max_bin;
+        for (const auto& c : columns) {
+            map.counts.emplace_back(c.begin() + map.min_bin, c.begin() + map.max_bin + 1);
+        }
+        return map;
+    }
+
+    // Per-function latency of two versions inside [from, to], merged from
+    // the segments' (function, version) sketches. Only functions seen in
+    // both versions are returned.
+    std::vector<VersionComparison> compare_versions(int project_id, uint32_t base_id, uint32_t head_id,
+                                                    int64_t from = INT64_MIN, int64_t to = INT64_MAX) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+
+        std::map<uint32_t, VersionComparison> by_func;
+        std::vector<int64_t> ts;
+        std::vector<uint64_t> durations;
+        std::vector<uint32_t> func_ids, version_ids;
+
+        for (const auto& seg : segments->segments(project_id, from, to)) {
+            if (seg.min_ts >= from && seg.max_ts <= to) {
+                for (const auto& fv : segments->sketches(seg).func_versions) {
+                    if (fv.first.second == base_id) by_func[fv.first.first].base.merge(fv.second);
+                    if (fv.first.second == head_id) by_func[fv.first.first].head.merge(fv.second);
+                }
+                continue;
+            }
+
+            segments->read_column(seg, COL_TIMESTAMP, ts);
+            segments->read_column(seg, COL_DURATION, durations);
+            segments->read_column(seg, COL_FUNC_ID, func_ids);
+            segments->read_column(seg, COL_VERSION_ID, version_ids);
+            size_t n = std::min(std::min(ts.size(), durations.size()), std::min(func_ids.size(), version_ids.size()));
+            for (size_t i = 0; i < n; i++) {
+                if (ts[i] < from || ts[i] > to) continue;
+                if (version_ids[i] == base_id) by_func[func_ids[i]].base.add(durations[i]);
+                if (version_ids[i] == head_id) by_func[func_ids[i]].head.add(durations[i]);
+            }
+        }
+
+        std::vector<VersionComparison> result;
+        for (auto& f : by_func) {
+            if (f.second.base.empty() || f.second.head.empty()) continue;
+            f.second.func_id = f.first;
+            f.second.func = dict->resolve(project_id, DICT_FUNC, f.first);
+            result.push_back(std::move(f.second));
+        }
+        return result;
+    }
+
+    // One merged row per bucket of `level` overlapping [from, to], for the
+    // whole project or a single function.
+    std::vector<std::pair<int64_t, RollupRow>> rollup_series(int project_id, RollupLevel level,
+                                                             int64_t from = INT64_MIN, int64_t to = INT64_MAX,
+                                                             const uint32_t* func_id = nullptr) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+
+        std::vector<std::pair<int64_t, RollupRow>> series;
+        rollups->scan(project_id, level, from, to, [&](int64_t bucket, uint32_t func, const RollupRow& row) {
+            if (func_id && func != *func_id) return;
+            if (series.empty() || series.back().first != bucket) series.emplace_back(bucket, RollupRow());
+            series.back().second.merge(row);
+        });
+        return series;
+    }
+
+    // Opts a project in or out of message search. Disabling removes its
+    // trigram files; enabling lets build_text_indexes() backfill them.
+    bool set_text_search(int project_id, bool enabled) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        if (!enabled) {
+            for (const auto& seg : segments->segments(project_id)) {
+                std::error_code ec;
+                std::filesystem::remove(TextIndex::file_in(seg.dir), ec);
+                text_indexed.erase(seg.dir);
+            }
+        }
+        return text_index->set_enabled(project_id, enabled);
+    }
+
+    bool text_search_enabled(int project_id) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        return text_index->enabled(project_id);
+    }
+
+    // Indexes up to `max_segments` sealed segments of opted-in projects
+    // that have no trigram file yet, oldest first. Meant to be called
+    // periodically from a single background thread; db_mutex is held only
+    // to pick a segment, copy heap pages and publish the result. Returns
+    // how many were built.
+    size_t build_text_indexes(size_t max_segments) {
+        size_t built = 0;
+        std::unordered_set<std::string> failed;
+        while (built < max_segments) {
+            SegmentInfo seg;
+            std::vector<TextDoc> docs;
+            bool picked = false;
+            {
+                std::lock_guard<std::mutex> lock(db_mutex);
+                for (int project_id : text_index->projects()) {
+                    for (const auto& s : segments->segments(project_id)) {
+                        if (!s.sealed || text_indexed.count(s.dir) || failed.count(s.dir)) continue;
+                        if (std::filesystem::exists(TextIndex::file_in(s.dir))) {
+                            text_indexed.insert(s.dir);
+                            continue;
+                        }
+                        if (!text_docs(s, docs)) {
+                            failed.insert(s.dir);
+                            continue;
+                        }
+                        seg = s;
+                        picked = true;
+                        break;
+                    }
+                    if (picked) break;
+                }
+            }
+            if (!picked) break;
+
+            std::string file = TextIndex::file_in(seg.dir);
+            if (!build_text_index(seg, docs)) {
+                std::cerr << "[ExecTraceDB] Failed to index messages in " << seg.dir << std::endl;
+                failed.insert(seg.dir);
+                continue;
+            }
+
+            // The project may have opted out or the segment been dropped
+            // while the file was being built
+            std::lock_guard<std::mutex> lock(db_mutex);
+            bool live = false;
+            if (text_index->enabled(seg.project_id)) {
+                for (const auto& s : segments->segments(seg.project_id)) {
+                    if (s.dir == seg.dir) live = true;
+                }
+            }
+            if (!live) {
+                std::error_code ec;
+                std::filesystem::remove(file, ec);
+                continue;
+            }
+            text_indexed.insert(seg.dir);
+            std::cout << "[ExecTraceDB] Indexed " << docs.size() << " messages in " << seg.dir << std::endl;
+            built++;
+        }
+        return built;
+    }
+
+    // Traces of a project in [from, to] whose message contains `query`
+    // (case-insensitive, at least 3 characters), newest first. Indexed
+    // segments are narrowed with their trigram postings; the rest (the
+    // open segment, or everything if the project is not opted in) are
+    // scanned through the timestamp index. `indexed` counts segments
+    // answered from an index.
+    std::vector<ExecTrace::TraceEntry> search_messages(int project_id, const std::string& query, size_t limit,
+                                                       size_t& indexed, int64_t from = INT64_MIN,
+                                                       int64_t to = INT64_MAX) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+
+        std::vector<ExecTrace::TraceEntry> results;
+        indexed = 0;
+        std::string needle = query;
+        for (auto& c : needle) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        std::vector<uint32_t> grams;
+        TextIndex::trigrams(needle, grams);
+        if (grams.empty() || limit == 0) return results;
+
+        std::unordered_set<int> seen;
+        ExecTrace::TraceEntry entry;
+        auto take = [&](int id, const RecordId& rid) {
+            if (seen.count(id) || !fetch_live(rid, entry) || entry.id != id) return;
+            if (!TextIndex::contains(entry.message, needle)) return;
+            seen.insert(id);
+            resolve_strings(entry);
+            results.push_back(entry);
+        };
+
+        bool enabled = text_index->enabled(project_id);
+        std::vector<SegmentInfo> segs = segments->segments(project_id, from, to);
+        std::vector<TextDoc> docs;
+        for (auto seg = segs.rbegin(); seg != segs.rend() && results.size() < limit; ++seg) {
+            if (enabled && seg->sealed && TextIndex::candidates(TextIndex::file_in(seg->dir), grams, docs)) {
+                indexed++;
+                for (auto doc = docs.rbegin(); doc != docs.rend() && results.size() < limit; ++doc) {
+                    if (doc->timestamp < from || doc->timestamp > to) continue;
+                    take(doc->id, RecordId(doc->page_id, doc->slot));
+                }
+                continue;
+            }
+
+            time_index->tree->scan_range_reverse(
+                ExecTrace::ProjectTimeKey(project_id, std::max(from, seg->min_ts), INT_MIN),
+                ExecTrace::ProjectTimeKey(project_id, std::min(to, seg->max_ts), INT_MAX),
+                [&](const ExecTrace::ProjectTimeKey& key) {
+                    take(key.id, RecordId(key.page_id, key.slot));
+                    return results.size() < limit;
+                });
+        }
+        return results;
+    }
+
+    // Deletes the traces of a project's sealed segments that end before
+    // `before_ts`: the heap rows are tombstoned, their index keys removed,
+    // the segment directories (columns, sketches, trigram files) deleted
+    // and the rollup buckets they fell in rebuilt from what is left.
+    // Returns the number of segments dropped.
+    size_t drop_segments_before(int project_id, int64_t before_ts) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+
+        int64_t lo = INT64_MAX, hi = INT64_MIN;
+        size_t dropped = segments->drop_before(project_id, before_ts, [&](const SegmentInfo& seg) {
+            delete_segment_rows(seg);
+            text_indexed.erase(seg.dir);
+            if (seg.rows > 0) {
+                lo = std::min(lo, seg.min_ts);
+                hi = std::max(hi, seg.max_ts);
+            }
+        });
+        if (dropped == 0) return 0;
+
+        if (lo <= hi) rebuild_rollups(project_id, lo, hi);
+        // Running aggregates now have to match what is left
+        stats->set(aggregate_segments(project_id, INT64_MIN, INT64_MAX));
+        stats->flush();
+        return dropped;
+    }
 };
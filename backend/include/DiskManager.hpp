@@ -5,6 +5,8 @@
 #include <mutex>
 #include <cstring>
 #include <iostream>
+#include <algorithm>
+#include <stdexcept>
 
 const int PAGE_SIZE = 4096;
 
@@ -35,7 +37,7 @@ public:
             
             db_file.seekg(0, std::ios::end);
             size_t file_size = db_file.tellg();
-            next_page_id = (file_size / PAGE_SIZE) + 1;
+            next_page_id = std::max<int>(1, file_size / PAGE_SIZE);
             
             std::cout << "[DiskManager] Opened existing database: " << filename 
                       << " (" << (file_size / PAGE_SIZE) << " pages)" << std::endl;
@@ -75,4 +77,13 @@ public:
         std::lock_guard<std::mutex> lock(file_mutex);
         return next_page_id++;
     }
+
+    int page_count() const {
+        std::lock_guard<std::mutex> lock(file_mutex);
+        return next_page_id;
+    }
+
+    const std::string& filename() const {
+        return db_filename;
+    }
 };
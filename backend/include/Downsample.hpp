@@ -0,0 +1,122 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+struct SeriesPoint {
+    int64_t timestamp;
+    uint64_t value;
+};
+
+// Largest-Triangle-Three-Buckets downsampling (Steinarsson, 2013) over a
+// stream of `total` points in time order. The first and last points are
+// kept; the points between are split into threshold - 2 equal-count buckets
+// and from each the point forming the largest triangle with the previously
+// kept point and the next bucket's average is selected. Only two buckets
+// are buffered at a time, so memory is O(total / threshold).
+class LttbSampler {
+private:
+    size_t total;
+    size_t threshold;
+    double every;
+    size_t seen;
+    size_t filling;       // bucket being collected into `next`
+    size_t filling_end;   // first stream index past that bucket
+    std::vector<SeriesPoint> out;
+    std::vector<SeriesPoint> current;  // bucket filling - 1, awaiting selection
+    std::vector<SeriesPoint> next;
+
+    bool sampling() const {
+        return threshold >= 3 && threshold < total;
+    }
+
+    size_t bucket_end(size_t bucket) const {
+        if (bucket + 1 >= threshold - 2) return total - 1;
+        return static_cast<size_t>(std::floor((bucket + 1) * every)) + 1;
+    }
+
+    void select(const std::vector<SeriesPoint>& bucket, double cx, double cy) {
+        if (bucket.empty()) return;
+        const SeriesPoint& a = out.back();
+        double ax = static_cast<double>(a.timestamp);
+        double ay = static_cast<double>(a.value);
+
+        double best_area = -1;
+        const SeriesPoint* best = &bucket.front();
+        for (const auto& p : bucket) {
+            double area = std::fabs((ax - cx) * (static_cast<double>(p.value) - ay) -
+                                    (ax - static_cast<double>(p.timestamp)) * (cy - ay));
+            if (area > best_area) {
+                best_area = area;
+                best = &p;
+            }
+        }
+        out.push_back(*best);
+    }
+
+    void select_with_average(const std::vector<SeriesPoint>& bucket, const std::vector<SeriesPoint>& following) {
+        double sx = 0, sy = 0;
+        for (const auto& p : following) {
+            sx += static_cast<double>(p.timestamp);
+            sy += static_cast<double>(p.value);
+        }
+        double n = static_cast<double>(std::max<size_t>(following.size(), 1));
+        select(bucket, sx / n, sy / n);
+    }
+
+    // Selects from the last two buckets once the final point arrives; the
+    // last bucket is weighed against that point itself.
+    void finish_buckets(const SeriesPoint& last) {
+        if (filling > 0) select_with_average(current, next);
+        select(next, static_cast<double>(last.timestamp), static_cast<double>(last.value));
+        current.clear();
+        next.clear();
+    }
+
+public:
+    LttbSampler(size_t total_points, size_t max_points)
+        : total(total_points), threshold(max_points), seen(0), filling(0) {
+        every = sampling() ? static_cast<double>(total - 2) / (threshold - 2) : 0;
+        filling_end = sampling() ? bucket_end(0) : 0;
+        out.reserve(std::min(total, threshold));
+    }
+
+    void push(int64_t timestamp, uint64_t value) {
+        SeriesPoint p{timestamp, value};
+        size_t i = seen++;
+        if (!sampling() || i == 0) {
+            out.push_back(p);
+            return;
+        }
+        if (i >= total - 1) {
+            if (i == total - 1) {
+                finish_buckets(p);
+                out.push_back(p);
+            }
+            return;
+        }
+
+        while (i >= filling_end) {
+            if (filling > 0) select_with_average(current, next);
+            current.swap(next);
+            next.clear();
+            filling++;
+            filling_end = bucket_end(filling);
+        }
+        next.push_back(p);
+    }
+
+    // The selected points, in time order. If fewer than `total` points were
+    // pushed, the newest one pushed stands in for the last point.
+    std::vector<SeriesPoint> take() {
+        if (sampling() && seen > 1 && seen < total && (!next.empty() || !current.empty())) {
+            if (next.empty()) next.swap(current);
+            SeriesPoint last = next.back();
+            next.pop_back();
+            finish_buckets(last);
+            out.push_back(last);
+        }
+        return std::move(out);
+    }
+};
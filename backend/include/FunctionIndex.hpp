@@ -0,0 +1,100 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// One autocomplete suggestion.
+struct FunctionSuggestion {
+    std::string func;
+    uint64_t calls;
+};
+
+// In-memory type-ahead over each project's function names. Names live in
+// an array sorted by their lowercased form, so a prefix is a binary search
+// plus a scan of the matching run; call counts are indexed by dictionary
+// id. A new function costs one sorted insert, which only happens the first
+// time it is seen.
+class FunctionIndex {
+private:
+    struct Name {
+        std::string key;   // lowercased, the sort key
+        uint32_t func_id;
+    };
+
+    struct ProjectFunctions {
+        std::vector<Name> names;
+        std::vector<uint64_t> calls;  // by func_id
+    };
+
+    std::unordered_map<int, ProjectFunctions> projects;
+
+    static std::string lower(const std::string& s) {
+        std::string out = s;
+        for (auto& c : out) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        return out;
+    }
+
+public:
+    // Replaces a project's names in one sort; names[i] is function id i + 1.
+    void load(int project_id, const std::vector<std::string>& names) {
+        ProjectFunctions& p = projects[project_id];
+        p.names.clear();
+        p.names.reserve(names.size());
+        for (size_t i = 0; i < names.size(); i++) {
+            p.names.push_back(Name{lower(names[i]), static_cast<uint32_t>(i + 1)});
+        }
+        std::sort(p.names.begin(), p.names.end(), [](const Name& a, const Name& b) {
+            return a.key < b.key;
+        });
+        p.calls.assign(names.size() + 1, 0);
+    }
+
+    // Registers `func_id` under `name` unless the id is already known.
+    // Dictionary ids are dense, so any id below the known range is.
+    void add_function(int project_id, uint32_t func_id, const std::string& name) {
+        if (func_id == 0) return;
+        ProjectFunctions& p = projects[project_id];
+        if (func_id < p.calls.size()) return;
+        p.calls.resize(func_id + 1, 0);
+
+        Name entry{lower(name), func_id};
+        auto pos = std::upper_bound(p.names.begin(), p.names.end(), entry, [](const Name& a, const Name& b) {
+            return a.key < b.key;
+        });
+        p.names.insert(pos, std::move(entry));
+    }
+
+    void add_calls(int project_id, uint32_t func_id, uint64_t calls) {
+        auto it = projects.find(project_id);
+        if (it == projects.end() || func_id >= it->second.calls.size()) return;
+        it->second.calls[func_id] += calls;
+    }
+
+    // Up to `limit` function ids whose name starts with `prefix`
+    // (case-insensitive), most called first, with their call counts.
+    std::vector<std::pair<uint32_t, uint64_t>> complete(int project_id, const std::string& prefix, size_t limit) const {
+        std::vector<std::pair<uint32_t, uint64_t>> matches;
+        auto it = projects.find(project_id);
+        if (it == projects.end() || limit == 0) return matches;
+        const ProjectFunctions& p = it->second;
+
+        std::string key = lower(prefix);
+        auto first = std::lower_bound(p.names.begin(), p.names.end(), key, [](const Name& a, const std::string& k) {
+            return a.key < k;
+        });
+        for (auto n = first; n != p.names.end() && n->key.compare(0, key.size(), key) == 0; ++n) {
+            matches.push_back({n->func_id, p.calls[n->func_id]});
+        }
+
+        auto order = [](const std::pair<uint32_t, uint64_t>& a, const std::pair<uint32_t, uint64_t>& b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        };
+        size_t n = std::min(limit, matches.size());
+        std::partial_sort(matches.begin(), matches.begin() + n, matches.end(), order);
+        matches.resize(n);
+        return matches;
+    }
+};
@@ -0,0 +1,116 @@
+#pragma once
+#include <cstdint>
+#include <iterator>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+enum HitterMetric {
+    HITTERS_CALLS = 0,   // number of calls
+    HITTERS_TIME         // total duration
+};
+
+// One entry of a top-k answer. The true weight lies in
+// [count - error, count]; `guaranteed` means it is certainly in the top k.
+struct HeavyHitter {
+    uint32_t key;
+    uint64_t count;
+    uint64_t error;
+    bool guaranteed;
+
+    HeavyHitter() : key(0), count(0), error(0), guaranteed(false) {}
+};
+
+// Weighted Space-Saving summary (Metwally et al.) keeping at most
+// `capacity` counters. A key that is not tracked takes over the smallest
+// counter and inherits its count as error, so every key whose total weight
+// exceeds total / capacity is always present.
+class SpaceSaving {
+private:
+    struct Counter {
+        uint64_t count;
+        uint64_t error;
+    };
+
+    size_t capacity;
+    std::unordered_map<uint32_t, Counter> counters;
+    std::set<std::pair<uint64_t, uint32_t>> by_count;  // (count, key), smallest first
+
+public:
+    SpaceSaving(size_t max_counters = 1024) : capacity(max_counters) {}
+
+    void add(uint32_t key, uint64_t weight) {
+        auto it = counters.find(key);
+        if (it != counters.end()) {
+            by_count.erase({it->second.count, key});
+            it->second.count += weight;
+            by_count.insert({it->second.count, key});
+            return;
+        }
+
+        Counter counter{weight, 0};
+        if (counters.size() >= capacity) {
+            auto smallest = by_count.begin();
+            counter.error = smallest->first;
+            counter.count += smallest->first;
+            counters.erase(smallest->second);
+            by_count.erase(smallest);
+        }
+        counters[key] = counter;
+        by_count.insert({counter.count, key});
+    }
+
+    // The k largest counters, largest first.
+    std::vector<HeavyHitter> top(size_t k) const {
+        std::vector<HeavyHitter> result;
+        for (auto it = by_count.rbegin(); it != by_count.rend() && result.size() < k; ++it) {
+            const Counter& c = counters.at(it->second);
+            HeavyHitter h;
+            h.key = it->second;
+            h.count = c.count;
+            h.error = c.error;
+            result.push_back(h);
+        }
+
+        // Anything outside the answer counts at most the next counter
+        auto next = by_count.rbegin();
+        std::advance(next, result.size());
+        uint64_t bound = next == by_count.rend() ? 0 : next->first;
+        for (auto& h : result) h.guaranteed = h.count - h.error >= bound;
+        return result;
+    }
+
+    size_t size() const { return counters.size(); }
+};
+
+// Per-project Space-Saving summaries of function call counts and total
+// time, kept in memory and updated at ingest. Memory is bounded by
+// 2 * capacity counters per project however many functions there are.
+class HeavyHitters {
+private:
+    size_t capacity;
+    std::unordered_map<int, std::vector<SpaceSaving>> projects;
+
+    std::vector<SpaceSaving>& summaries(int project_id) {
+        auto it = projects.find(project_id);
+        if (it == projects.end()) {
+            it = projects.emplace(project_id, std::vector<SpaceSaving>(2, SpaceSaving(capacity))).first;
+        }
+        return it->second;
+    }
+
+public:
+    HeavyHitters(size_t counters_per_metric = 1024) : capacity(counters_per_metric) {}
+
+    void add(int project_id, uint32_t func_id, uint64_t calls, uint64_t duration) {
+        std::vector<SpaceSaving>& s = summaries(project_id);
+        s[HITTERS_CALLS].add(func_id, calls);
+        s[HITTERS_TIME].add(func_id, duration);
+    }
+
+    std::vector<HeavyHitter> top(int project_id, HitterMetric metric, size_t k) const {
+        auto it = projects.find(project_id);
+        if (it == projects.end()) return {};
+        return it->second[metric].top(k);
+    }
+};
@@ -0,0 +1,120 @@
+#pragma once
+#include "SlottedPage.hpp"
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Mergeable distinct-count estimator over 32-bit ids (Flajolet et al.,
+// with linear counting for small cardinalities). 2^11 registers give a
+// standard error of ~2.3%. A sketch starts sparse, holding only the
+// registers that were set, and switches to a dense 2 KB array once that
+// stops being smaller, so memory is bounded whatever the cardinality.
+// Merging takes the register-wise max, which is exactly the sketch of the
+// union of both inputs.
+class HyperLogLog {
+private:
+    static const int PRECISION = 11;
+    static const uint32_t REGISTERS = 1u << PRECISION;
+    static const size_t SPARSE_LIMIT = 64;
+
+    std::map<uint16_t, uint8_t> sparse;
+    std::vector<uint8_t> dense;  // empty while sparse
+
+    static uint64_t hash(uint32_t key) {
+        uint64_t x = key + 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    void set(uint16_t index, uint8_t rank) {
+        if (!dense.empty()) {
+            if (rank > dense[index]) dense[index] = rank;
+            return;
+        }
+        uint8_t& r = sparse[index];
+        if (rank > r) r = rank;
+        if (sparse.size() > SPARSE_LIMIT) {
+            dense.assign(REGISTERS, 0);
+            for (const auto& s : sparse) dense[s.first] = s.second;
+            sparse.clear();
+        }
+    }
+
+public:
+    void add(uint32_t key) {
+        uint64_t h = hash(key);
+        uint16_t index = static_cast<uint16_t>(h >> (64 - PRECISION));
+        uint64_t rest = h << PRECISION;
+        uint8_t rank = rest == 0 ? 64 - PRECISION + 1 : static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+        set(index, rank);
+    }
+
+    void merge(const HyperLogLog& other) {
+        if (!other.dense.empty()) {
+            for (uint32_t i = 0; i < REGISTERS; i++) {
+                if (other.dense[i]) set(static_cast<uint16_t>(i), other.dense[i]);
+            }
+        } else {
+            for (const auto& s : other.sparse) set(s.first, s.second);
+        }
+    }
+
+    bool empty() const { return sparse.empty() && dense.empty(); }
+
+    uint64_t estimate() const {
+        const double m = REGISTERS;
+        double sum = 0;
+        uint32_t zeros = 0;
+        if (dense.empty()) {
+            zeros = REGISTERS - static_cast<uint32_t>(sparse.size());
+            sum = zeros;
+            for (const auto& s : sparse) sum += std::ldexp(1.0, -s.second);
+        } else {
+            for (uint8_t r : dense) {
+                sum += std::ldexp(1.0, -r);
+                if (r == 0) zeros++;
+            }
+        }
+
+        double e = (0.7213 / (1 + 1.079 / m)) * m * m / sum;
+        if (e <= 2.5 * m && zeros > 0) e = m * std::log(m / zeros);
+        return static_cast<uint64_t>(e + 0.5);
+    }
+
+    // [registers set:varint] then per register [index delta:varint][rank:u8]
+    void encode(std::string& out) const {
+        std::vector<std::pair<uint16_t, uint8_t>> set_registers;
+        if (dense.empty()) {
+            set_registers.assign(sparse.begin(), sparse.end());
+        } else {
+            for (uint32_t i = 0; i < REGISTERS; i++) {
+                if (dense[i]) set_registers.push_back({static_cast<uint16_t>(i), dense[i]});
+            }
+        }
+        put_varint(out, set_registers.size());
+        uint16_t prev = 0;
+        for (const auto& r : set_registers) {
+            put_varint(out, r.first - prev);
+            out.push_back(static_cast<char>(r.second));
+            prev = r.first;
+        }
+    }
+
+    bool decode(const char*& p, const char* end) {
+        *this = HyperLogLog();
+        uint64_t n;
+        if (!get_varint(p, end, n) || n > REGISTERS) return false;
+        uint64_t index = 0;
+        for (uint64_t i = 0; i < n; i++) {
+            uint64_t delta;
+            if (!get_varint(p, end, delta) || p >= end) return false;
+            index += delta;
+            if (index >= REGISTERS) return false;
+            set(static_cast<uint16_t>(index), static_cast<uint8_t>(*p++));
+        }
+        return true;
+    }
+};
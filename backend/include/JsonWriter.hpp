@@ -0,0 +1,226 @@
+#pragma once
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <charconv>
+#include <cmath>
+#include <type_traits>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Minimal streaming JSON serializer. Appends straight into one std::string,
+// either its own or a caller-provided buffer that is reused between calls,
+// and tracks commas per nesting level so handlers only call key()/value().
+//
+//   JsonWriter json(results.size() * 160);
+//   json.begin_object().key("count").value(results.size()).end_object();
+//   crow::response resp(200, json.take());
+//
+// Strings are escaped per RFC 8259. Clean runs are found 16 (SSE2) or 8
+// (SWAR) bytes at a time and copied in one append; only blocks containing a
+// quote, backslash or control byte take the per-byte path. Bytes >= 0x80 are
+// passed through unchanged.
+class JsonWriter {
+private:
+    static const int MAX_DEPTH = 32;
+
+    std::string own;
+    std::string* out;
+    int depth;
+    bool has_items[MAX_DEPTH];
+    bool after_key;
+
+    void separator() {
+        if (after_key) {
+            after_key = false;
+            return;
+        }
+        if (depth > 0 && depth <= MAX_DEPTH) {
+            if (has_items[depth - 1]) out->push_back(',');
+            has_items[depth - 1] = true;
+        }
+    }
+
+    void open(char c) {
+        separator();
+        out->push_back(c);
+        if (depth < MAX_DEPTH) has_items[depth] = false;
+        depth++;
+    }
+
+    void close(char c) {
+        out->push_back(c);
+        if (depth > 0) depth--;
+    }
+
+    static bool word_needs_escape(uint64_t w) {
+        const uint64_t ones = 0x0101010101010101ULL;
+        const uint64_t highs = 0x8080808080808080ULL;
+        uint64_t control = (w - ones * 0x20) & ~w & highs;
+        uint64_t q = w ^ (ones * '"');
+        uint64_t b = w ^ (ones * '\\');
+        uint64_t quote = (q - ones) & ~q & highs;
+        uint64_t backslash = (b - ones) & ~b & highs;
+        return (control | quote | backslash) != 0;
+    }
+
+    // Length of the prefix of s that needs no escaping.
+    static size_t clean_prefix(const char* s, size_t n) {
+        size_t i = 0;
+#ifdef __SSE2__
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i control_max = _mm_set1_epi8(0x1F);
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+            __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash));
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_max_epu8(v, control_max), control_max));
+            if (_mm_movemask_epi8(hit) != 0) break;
+        }
+#endif
+        for (; i + 8 <= n; i += 8) {
+            uint64_t w;
+            memcpy(&w, s + i, sizeof(w));
+            if (word_needs_escape(w)) break;
+        }
+        for (; i < n; i++) {
+            unsigned char c = static_cast<unsigned char>(s[i]);
+            if (c < 0x20 || c == '"' || c == '\\') break;
+        }
+        return i;
+    }
+
+    void write_escaped(const char* s, size_t n) {
+        static const char hex[] = "0123456789abcdef";
+
+        out->push_back('"');
+        while (n > 0) {
+            size_t clean = clean_prefix(s, n);
+            out->append(s, clean);
+            s += clean;
+            n -= clean;
+            if (n == 0) break;
+
+            unsigned char c = static_cast<unsigned char>(*s);
+            switch (c) {
+                case '"': out->append("\\\"", 2); break;
+                case '\\': out->append("\\\\", 2); break;
+                case '\n': out->append("\\n", 2); break;
+                case '\r': out->append("\\r", 2); break;
+                case '\t': out->append("\\t", 2); break;
+                case '\b': out->append("\\b", 2); break;
+                case '\f': out->append("\\f", 2); break;
+                default: {
+                    char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+                    out->append(esc, sizeof(esc));
+                }
+            }
+            s++;
+            n--;
+        }
+        out->push_back('"');
+    }
+
+    template <typename T>
+    void write_number(T v) {
+        char buf[32];
+        auto res = std::to_chars(buf, buf + sizeof(buf), v);
+        out->append(buf, res.ptr - buf);
+    }
+
+public:
+    explicit JsonWriter(size_t reserve_bytes = 256) : out(&own), depth(0), after_key(false) {
+        own.reserve(reserve_bytes);
+    }
+
+    // Appends to `target`, keeping its capacity across uses.
+    explicit JsonWriter(std::string& target) : out(&target), depth(0), after_key(false) {}
+
+    void reserve(size_t bytes) {
+        out->reserve(out->size() + bytes);
+    }
+
+    JsonWriter& begin_object() { open('{'); return *this; }
+    JsonWriter& end_object() { close('}'); return *this; }
+    JsonWriter& begin_array() { open('['); return *this; }
+    JsonWriter& end_array() { close(']'); return *this; }
+
+    // Keys are literals that need no escaping; the length is known at
+    // compile time so `"name":` goes out in a single append.
+    template <size_t N>
+    JsonWriter& key(const char (&name)[N]) {
+        separator();
+        char buf[N + 2];
+        buf[0] = '"';
+        memcpy(buf + 1, name, N - 1);
+        buf[N] = '"';
+        buf[N + 1] = ':';
+        out->append(buf, N + 2);
+        after_key = true;
+        return *this;
+    }
+
+    JsonWriter& value(const char* s) {
+        separator();
+        write_escaped(s, strlen(s));
+        return *this;
+    }
+
+    JsonWriter& value(const std::string& s) {
+        separator();
+        write_escaped(s.data(), s.size());
+        return *this;
+    }
+
+    JsonWriter& value(bool b) {
+        separator();
+        if (b) {
+            out->append("true", 4);
+        } else {
+            out->append("false", 5);
+        }
+        return *this;
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, JsonWriter&>::type
+    value(T v) {
+        separator();
+        write_number(v);
+        return *this;
+    }
+
+    JsonWriter& value(double v) {
+        separator();
+        if (!std::isfinite(v)) {
+            out->append("null", 4);
+        } else {
+            write_number(v);
+        }
+        return *this;
+    }
+
+    JsonWriter& null_value() {
+        separator();
+        out->append("null", 4);
+        return *this;
+    }
+
+    // Pre-serialized JSON, e.g. a fragment built by another writer.
+    JsonWriter& raw(const std::string& json) {
+        separator();
+        out->append(json);
+        return *this;
+    }
+
+    const std::string& str() const {
+        return *out;
+    }
+
+    std::string take() {
+        std::string result;
+        result.swap(*out);
+        return result;
+    }
+};
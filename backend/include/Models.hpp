@@ -2,6 +2,9 @@
 #include <cstring>
 #include <ctime>
 #include <cstdint>
+#include <string>
+#include <cstdio>
+#include <cctype>
 
 namespace ExecTrace {
 
@@ -11,12 +14,15 @@ struct TraceEntry {
     char func[128];
     char message[256];
     char app_version[32];
+    uint32_t func_id;     // StringDictionary ids, 0 if not interned
+    uint32_t version_id;
     uint64_t duration;
     uint64_t ram_usage;
     time_t timestamp;
     bool is_deleted; 
 
-    TraceEntry() : id(0), project_id(0), duration(0), ram_usage(0), timestamp(0), is_deleted(false) {
+    TraceEntry() : id(0), project_id(0), func_id(0), version_id(0), duration(0), ram_usage(0),
+                   timestamp(0), is_deleted(false) {
         memset(func, 0, sizeof(func));
         memset(message, 0, sizeof(message));
         memset(app_version, 0, sizeof(app_version));
@@ -25,7 +31,7 @@ struct TraceEntry {
     TraceEntry(int entry_id, int proj_id, const char* function, 
                const char* msg, const char* version, 
                uint64_t dur, uint64_t ram) 
-        : id(entry_id), project_id(proj_id), duration(dur), 
+        : id(entry_id), project_id(proj_id), func_id(0), version_id(0), duration(dur), 
           ram_usage(ram), timestamp(time(nullptr)), is_deleted(false) {
 
         memset(func, 0, sizeof(func));
@@ -61,7 +67,7 @@ struct TraceEntry {
                project_id > 0 &&
                duration < 3600000 &&  
                ram_usage < 104857600 &&  
-               func[0] != '\0' &&  
+               (func[0] != '\0' || func_id != 0) &&  
                !is_deleted;
     }
 
@@ -70,6 +76,179 @@ struct TraceEntry {
     }
 };
 
+// Secondary index entry: (project_id, timestamp, id) plus the row's heap
+// location, so a range scan can fetch rows without a primary lookup.
+struct ProjectTimeKey {
+    int project_id;
+    int64_t timestamp;
+    int id;
+    int page_id;
+    int slot;
+
+    ProjectTimeKey() : project_id(0), timestamp(0), id(0), page_id(0), slot(-1) {}
+
+    ProjectTimeKey(int proj_id, int64_t ts, int entry_id, int page = 0, int s = -1)
+        : project_id(proj_id), timestamp(ts), id(entry_id), page_id(page), slot(s) {}
+
+    bool operator<(const ProjectTimeKey& other) const {
+        if (project_id != other.project_id) return project_id < other.project_id;
+        if (timestamp != other.timestamp) return timestamp < other.timestamp;
+        return id < other.id;
+    }
+
+    bool operator==(const ProjectTimeKey& other) const {
+        return project_id == other.project_id && timestamp == other.timestamp && id == other.id;
+    }
+
+    bool operator>(const ProjectTimeKey& other) const {
+        return other < *this;
+    }
+};
+
+struct FuncTimeKey {
+    int project_id;
+    uint32_t func_id;
+    int64_t timestamp;
+    int id;
+    int page_id;
+    int slot;
+
+    FuncTimeKey() : project_id(0), func_id(0), timestamp(0), id(0), page_id(0), slot(-1) {}
+
+    FuncTimeKey(int proj_id, uint32_t fid, int64_t ts, int entry_id, int page = 0, int s = -1)
+        : project_id(proj_id), func_id(fid), timestamp(ts), id(entry_id), page_id(page), slot(s) {}
+
+    bool operator<(const FuncTimeKey& other) const {
+        if (project_id != other.project_id) return project_id < other.project_id;
+        if (func_id != other.func_id) return func_id < other.func_id;
+        if (timestamp != other.timestamp) return timestamp < other.timestamp;
+        return id < other.id;
+    }
+
+    bool operator==(const FuncTimeKey& other) const {
+        return project_id == other.project_id && func_id == other.func_id &&
+               timestamp == other.timestamp && id == other.id;
+    }
+
+    bool operator>(const FuncTimeKey& other) const {
+        return other < *this;
+    }
+};
+
+// Position of the last row of a /logs page. Serialized as 24 hex digits
+// (timestamp then id) so clients treat it as an opaque token.
+struct TraceCursor {
+    int64_t timestamp;
+    int id;
+
+    TraceCursor() : timestamp(0), id(0) {}
+    TraceCursor(int64_t ts, int entry_id) : timestamp(ts), id(entry_id) {}
+
+    std::string encode() const {
+        char buf[25];
+        snprintf(buf, sizeof(buf), "%016llx%08x", static_cast<unsigned long long>(timestamp),
+                 static_cast<unsigned int>(id));
+        return buf;
+    }
+
+    static bool decode(const std::string& token, TraceCursor& out) {
+        if (token.size() != 24) return false;
+        for (char c : token) {
+            if (!isxdigit(static_cast<unsigned char>(c))) return false;
+        }
+        out.timestamp = static_cast<int64_t>(std::stoull(token.substr(0, 16), nullptr, 16));
+        out.id = static_cast<int>(std::stoul(token.substr(16), nullptr, 16));
+        return true;
+    }
+};
+
+// Ordered slowest first within a project. The timestamp rides along so a
+// time window can be applied without touching the heap.
+struct DurationKey {
+    int project_id;
+    uint64_t duration;
+    int id;
+    int64_t timestamp;
+    int page_id;
+    int slot;
+
+    DurationKey() : project_id(0), duration(0), id(0), timestamp(0), page_id(0), slot(-1) {}
+
+    DurationKey(int proj_id, uint64_t dur, int entry_id, int64_t ts = 0, int page = 0, int s = -1)
+        : project_id(proj_id), duration(dur), id(entry_id), timestamp(ts), page_id(page), slot(s) {}
+
+    bool operator<(const DurationKey& other) const {
+        if (project_id != other.project_id) return project_id < other.project_id;
+        if (duration != other.duration) return duration > other.duration;
+        return id < other.id;
+    }
+
+    bool operator==(const DurationKey& other) const {
+        return project_id == other.project_id && duration == other.duration && id == other.id;
+    }
+
+    bool operator>(const DurationKey& other) const {
+        return other < *this;
+    }
+};
+
+// Key of the flagged-events index: a project's anomalous traces in
+// timestamp order, carrying why they were flagged.
+struct FlaggedKey {
+    int project_id;
+    int64_t timestamp;
+    int id;
+    int page_id;
+    int slot;
+    uint32_t reasons;
+    float z_score;
+
+    FlaggedKey() : project_id(0), timestamp(0), id(0), page_id(0), slot(-1), reasons(0), z_score(0) {}
+
+    FlaggedKey(int proj_id, int64_t ts, int entry_id, int page = 0, int s = -1,
+               uint32_t why = 0, float z = 0)
+        : project_id(proj_id), timestamp(ts), id(entry_id), page_id(page), slot(s),
+          reasons(why), z_score(z) {}
+
+    bool operator<(const FlaggedKey& other) const {
+        if (project_id != other.project_id) return project_id < other.project_id;
+        if (timestamp != other.timestamp) return timestamp < other.timestamp;
+        return id < other.id;
+    }
+
+    bool operator==(const FlaggedKey& other) const {
+        return project_id == other.project_id && timestamp == other.timestamp && id == other.id;
+    }
+
+    bool operator>(const FlaggedKey& other) const {
+        return other < *this;
+    }
+};
+
+struct ProjectStats {
+    int project_id;
+    uint64_t count;
+    uint64_t total_duration;
+    uint64_t min_duration;
+    uint64_t max_duration;
+    uint64_t total_ram;
+    uint64_t min_ram;
+    uint64_t max_ram;
+
+    ProjectStats() : project_id(0), count(0), total_duration(0), min_duration(UINT64_MAX),
+                     max_duration(0), total_ram(0), min_ram(UINT64_MAX), max_ram(0) {}
+
+    void add(uint64_t duration, uint64_t ram) {
+        count++;
+        total_duration += duration;
+        total_ram += ram;
+        if (duration < min_duration) min_duration = duration;
+        if (duration > max_duration) max_duration = duration;
+        if (ram < min_ram) min_ram = ram;
+        if (ram > max_ram) max_ram = ram;
+    }
+};
+
 enum UserRole {
     ROLE_USER = 0,    
     ROLE_EDITOR = 1,  
@@ -0,0 +1,121 @@
+#pragma once
+#include "DiskManager.hpp"
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+// Running per-project aggregates kept in fixed-size slots on stats pages.
+// Slot i lives at page i / SLOTS_PER_PAGE; a slot with count == 0 is free.
+// Everything is cached in memory, so reads never touch the file. Updates
+// only mark their page dirty; flush() writes the dirty pages back.
+class ProjectStatsStore {
+private:
+    static const int SLOTS_PER_PAGE = PAGE_SIZE / sizeof(ExecTrace::ProjectStats);
+
+    DiskManager* dm;
+    std::vector<std::vector<char>> pages;
+    std::unordered_map<int, int> slots;  // project_id -> slot
+    std::vector<bool> dirty;              // per page
+    int next_slot;
+
+    ExecTrace::ProjectStats* slot_ptr(int slot) {
+        return reinterpret_cast<ExecTrace::ProjectStats*>(pages[slot / SLOTS_PER_PAGE].data()) +
+               slot % SLOTS_PER_PAGE;
+    }
+
+    const ExecTrace::ProjectStats* slot_ptr(int slot) const {
+        return reinterpret_cast<const ExecTrace::ProjectStats*>(pages[slot / SLOTS_PER_PAGE].data()) +
+               slot % SLOTS_PER_PAGE;
+    }
+
+    void mark_dirty(int slot) {
+        dirty[slot / SLOTS_PER_PAGE] = true;
+    }
+
+    int slot_for(int project_id) {
+        auto it = slots.find(project_id);
+        if (it != slots.end()) return it->second;
+
+        int slot = next_slot++;
+        if (slot / SLOTS_PER_PAGE >= static_cast<int>(pages.size())) {
+            pages.emplace_back(PAGE_SIZE, '\0');
+            dirty.push_back(true);
+        }
+        slots[project_id] = slot;
+        return slot;
+    }
+
+public:
+    ProjectStatsStore(const std::string& filename) : next_slot(0) {
+        dm = new DiskManager(filename);
+
+        int page_count = dm->page_count();
+        for (int page_id = 0; page_id < page_count; page_id++) {
+            pages.emplace_back(PAGE_SIZE, '\0');
+            dirty.push_back(false);
+            dm->read_page(page_id, pages.back().data());
+
+            for (int i = 0; i < SLOTS_PER_PAGE; i++) {
+                int slot = page_id * SLOTS_PER_PAGE + i;
+                const ExecTrace::ProjectStats* stats = slot_ptr(slot);
+                if (stats->count > 0) {
+                    slots[stats->project_id] = slot;
+                    next_slot = slot + 1;
+                }
+            }
+        }
+
+        std::cout << "[ProjectStatsStore] Loaded stats for " << slots.size() << " projects" << std::endl;
+    }
+
+    ~ProjectStatsStore() {
+        flush();
+        delete dm;
+    }
+
+    void add(int project_id, uint64_t duration, uint64_t ram) {
+        int slot = slot_for(project_id);
+        ExecTrace::ProjectStats* stats = slot_ptr(slot);
+        if (stats->count == 0) {
+            *stats = ExecTrace::ProjectStats();
+            stats->project_id = project_id;
+        }
+        stats->add(duration, ram);
+        mark_dirty(slot);
+    }
+
+    // Replaces a project's aggregates, e.g. after old data was dropped.
+    void set(const ExecTrace::ProjectStats& stats) {
+        int slot = slot_for(stats.project_id);
+        *slot_ptr(slot) = stats;
+        mark_dirty(slot);
+    }
+
+    // Forgets every project, e.g. before rebuilding from the traces.
+    void clear() {
+        for (size_t page_id = 0; page_id < pages.size(); page_id++) {
+            std::fill(pages[page_id].begin(), pages[page_id].end(), '\0');
+            dirty[page_id] = true;
+        }
+        slots.clear();
+        next_slot = 0;
+    }
+
+    void flush() {
+        for (size_t page_id = 0; page_id < pages.size(); page_id++) {
+            if (!dirty[page_id]) continue;
+            dm->write_page(page_id, pages[page_id].data());
+            dirty[page_id] = false;
+        }
+    }
+
+    ExecTrace::ProjectStats get(int project_id) const {
+        auto it = slots.find(project_id);
+        if (it == slots.end()) {
+            ExecTrace::ProjectStats empty;
+            empty.project_id = project_id;
+            return empty;
+        }
+        return *slot_ptr(it->second);
+    }
+};
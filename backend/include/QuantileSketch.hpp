@@ -0,0 +1,197 @@
+#pragma once
+#include "SlottedPage.hpp"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <algorithm>
+
+// Mergeable latency histogram with HDR-style log-linear buckets. Values
+// below 64 get a bucket each; above that every power of two is split into
+// 32 sub-buckets, so a reported quantile is within ~1.6% of the true value.
+// Merging two sketches adds bucket counts, which makes the result exactly
+// the sketch of the union of their inputs.
+class LatencySketch {
+private:
+    static const uint32_t LINEAR_BUCKETS = 64;
+    static const int SUB_BUCKET_BITS = 5;
+    static const uint32_t SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+
+    std::map<uint32_t, uint64_t> buckets;
+    uint64_t total;
+    uint64_t min_value;
+    uint64_t max_value;
+
+public:
+    LatencySketch() : total(0), min_value(UINT64_MAX), max_value(0) {}
+
+    static uint32_t bucket_of(uint64_t v) {
+        if (v < LINEAR_BUCKETS) return static_cast<uint32_t>(v);
+        int e = 63 - __builtin_clzll(v);
+        uint32_t sub = static_cast<uint32_t>(v >> (e - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+        return LINEAR_BUCKETS + (e - 6) * SUB_BUCKETS + sub;
+    }
+
+    static uint64_t bucket_low(uint32_t b) {
+        if (b < LINEAR_BUCKETS) return b;
+        int e = (b - LINEAR_BUCKETS) / SUB_BUCKETS + 6;
+        uint64_t sub = (b - LINEAR_BUCKETS) % SUB_BUCKETS;
+        return (SUB_BUCKETS + sub) << (e - SUB_BUCKET_BITS);
+    }
+
+    static uint64_t bucket_high(uint32_t b) {
+        if (b < LINEAR_BUCKETS) return b;
+        int e = (b - LINEAR_BUCKETS) / SUB_BUCKETS + 6;
+        return bucket_low(b) + ((1ULL << (e - SUB_BUCKET_BITS)) - 1);
+    }
+
+    void add(uint64_t value, uint64_t n = 1) {
+        buckets[bucket_of(value)] += n;
+        total += n;
+        min_value = std::min(min_value, value);
+        max_value = std::max(max_value, value);
+    }
+
+    void merge(const LatencySketch& other) {
+        for (const auto& b : other.buckets) {
+            buckets[b.first] += b.second;
+        }
+        total += other.total;
+        min_value = std::min(min_value, other.min_value);
+        max_value = std::max(max_value, other.max_value);
+    }
+
+    uint64_t count() const { return total; }
+
+    // Bucket index -> count, in value order.
+    const std::map<uint32_t, uint64_t>& bucket_counts() const { return buckets; }
+
+    // Values recorded in buckets above the one `value` falls into.
+    uint64_t count_above(uint64_t value) const {
+        uint64_t above = 0;
+        for (auto it = buckets.upper_bound(bucket_of(value)); it != buckets.end(); ++it) {
+            above += it->second;
+        }
+        return above;
+    }
+    bool empty() const { return total == 0; }
+    uint64_t min() const { return total ? min_value : 0; }
+    uint64_t max() const { return max_value; }
+
+    // Value at rank ceil(q * count), reported as its bucket midpoint and
+    // clamped to the exact min/max.
+    uint64_t quantile(double q) const {
+        if (total == 0) return 0;
+        if (q <= 0) return min_value;
+        if (q >= 1) return max_value;
+
+        uint64_t rank = static_cast<uint64_t>(q * total);
+        if (static_cast<double>(rank) < q * total) rank++;
+        rank = std::max<uint64_t>(rank, 1);
+
+        uint64_t seen = 0;
+        for (const auto& b : buckets) {
+            seen += b.second;
+            if (seen >= rank) {
+                uint64_t mid = bucket_low(b.first) + (bucket_high(b.first) - bucket_low(b.first)) / 2;
+                return std::min(std::max(mid, min_value), max_value);
+            }
+        }
+        return max_value;
+    }
+
+    // [buckets:varint][min:varint][max:varint] then per bucket
+    // [index delta:varint][count:varint]
+    void encode(std::string& out) const {
+        put_varint(out, buckets.size());
+        put_varint(out, min());
+        put_varint(out, max_value);
+        uint32_t prev = 0;
+        for (const auto& b : buckets) {
+            put_varint(out, b.first - prev);
+            put_varint(out, b.second);
+            prev = b.first;
+        }
+    }
+
+    bool decode(const char*& p, const char* end) {
+        *this = LatencySketch();
+        uint64_t n, lo, hi;
+        if (!get_varint(p, end, n) || !get_varint(p, end, lo) || !get_varint(p, end, hi)) return false;
+
+        uint64_t index = 0;
+        for (uint64_t i = 0; i < n; i++) {
+            uint64_t delta, c;
+            if (!get_varint(p, end, delta) || !get_varint(p, end, c)) return false;
+            index += delta;
+            buckets[static_cast<uint32_t>(index)] = c;
+            total += c;
+        }
+        if (total > 0) {
+            min_value = lo;
+            max_value = hi;
+        }
+        return true;
+    }
+};
+
+// Sketches for one segment: the whole project, one per function id and one
+// per (function id, version id) pair.
+struct SketchSet {
+    LatencySketch all;
+    std::map<uint32_t, LatencySketch> funcs;
+    std::map<std::pair<uint32_t, uint32_t>, LatencySketch> func_versions;
+
+    void add(uint32_t func_id, uint32_t version_id, uint64_t duration) {
+        all.add(duration);
+        funcs[func_id].add(duration);
+        func_versions[{func_id, version_id}].add(duration);
+    }
+
+    void merge(const SketchSet& other) {
+        all.merge(other.all);
+        for (const auto& f : other.funcs) {
+            funcs[f.first].merge(f.second);
+        }
+        for (const auto& fv : other.func_versions) {
+            func_versions[fv.first].merge(fv.second);
+        }
+    }
+
+    void encode(std::string& out) const {
+        all.encode(out);
+        put_varint(out, funcs.size());
+        for (const auto& f : funcs) {
+            put_varint(out, f.first);
+            f.second.encode(out);
+        }
+        put_varint(out, func_versions.size());
+        for (const auto& fv : func_versions) {
+            put_varint(out, fv.first.first);
+            put_varint(out, fv.first.second);
+            fv.second.encode(out);
+        }
+    }
+
+    // Fails on truncated input, including files written before the
+    // per-version section existed, so callers rebuild them.
+    bool decode(const char* p, const char* end) {
+        funcs.clear();
+        func_versions.clear();
+        uint64_t n;
+        if (!all.decode(p, end) || !get_varint(p, end, n)) return false;
+        for (uint64_t i = 0; i < n; i++) {
+            uint64_t func_id;
+            if (!get_varint(p, end, func_id)) return false;
+            if (!funcs[static_cast<uint32_t>(func_id)].decode(p, end)) return false;
+        }
+
+        if (!get_varint(p, end, n)) return false;
+        for (uint64_t i = 0; i < n; i++) {
+            uint64_t func_id, version_id;
+            if (!get_varint(p, end, func_id) || !get_varint(p, end, version_id)) return false;
+            auto key = std::make_pair(static_cast<uint32_t>(func_id), static_cast<uint32_t>(version_id));
+            if (!func_versions[key].decode(p, end)) return false;
+        }
+        return true;
+    }
+};
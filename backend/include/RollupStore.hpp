@@ -0,0 +1,527 @@
+#pragma once
+#include "QuantileSketch.hpp"
+#include "HyperLogLog.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <stdexcept>
+#include <vector>
+
+enum RollupLevel {
+    ROLLUP_MINUTE = 0,
+    ROLLUP_HOUR,
+    ROLLUP_DAY,
+    ROLLUP_LEVELS
+};
+
+// Aggregates of the durations that fell into one bucket.
+struct RollupRow {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    LatencySketch sketch;
+
+    RollupRow() : count(0), sum(0), min(UINT64_MAX), max(0) {}
+
+    void add(uint64_t duration) {
+        count++;
+        sum += duration;
+        min = std::min(min, duration);
+        max = std::max(max, duration);
+        sketch.add(duration);
+    }
+
+    void merge(const RollupRow& other) {
+        count += other.count;
+        sum += other.sum;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+        sketch.merge(other.sketch);
+    }
+
+    double avg() const {
+        return count ? static_cast<double>(sum) / count : 0.0;
+    }
+};
+
+// Distinct functions and versions seen in one bucket of a project.
+struct DistinctRow {
+    HyperLogLog funcs;
+    HyperLogLog versions;
+
+    void add(uint32_t func_id, uint32_t version_id) {
+        funcs.add(func_id);
+        versions.add(version_id);
+    }
+
+    void merge(const DistinctRow& other) {
+        funcs.merge(other.funcs);
+        versions.merge(other.versions);
+    }
+};
+
+// Pre-aggregated duration rollups keyed by (project, func_id, bucket start)
+// at 1-minute, 1-hour and 1-day resolution, updated at ingest, plus one
+// DistinctRow per (project, bucket) for distinct counts. Rows are
+// grouped into partition files so a long-range chart reads a handful of
+// files:
+//
+//   <root>/p<project>/{1m,1h,1d}/<partition start>   (1m: one file per hour,
+//                                                     1h: per day, 1d: per 30 days)
+//   <root>/p<project>/applied                          (newest trace id on disk)
+//
+// Dirty partitions are written back on shutdown and otherwise at most once
+// a minute (1m), every 10 minutes (1h) or every hour (1d) of ingest time, so
+// the large 1d files are not rewritten each minute. Each partition file
+// records the newest trace id it includes, and applied_id() is the newest
+// id below every unwritten change, so after a crash the caller replays
+// traces newer than applied_id() and add() skips those a partition already
+// holds. Only partitions in use stay in memory: once more than
+// MAX_LOADED_PARTITIONS are loaded, the least recently used clean ones are
+// dropped and re-read on demand.
+class RollupStore {
+private:
+    struct Partition {
+        std::map<std::pair<int64_t, uint32_t>, RollupRow> rows;  // (bucket, func_id)
+        std::map<int64_t, DistinctRow> distinct;                  // by bucket
+        int applied_id;
+        int first_dirty_id;  // oldest trace id not yet written
+        uint64_t last_used;
+        bool loaded;
+        bool dirty;
+
+        Partition() : applied_id(0), first_dirty_id(0), last_used(0), loaded(false), dirty(false) {}
+    };
+
+    struct ProjectRollups {
+        std::map<int64_t, Partition> partitions[ROLLUP_LEVELS];
+        int applied_id;
+        int last_id;
+
+        ProjectRollups() : applied_id(0), last_id(0) {}
+    };
+
+    static const uint32_t PARTITION_MAGIC = 0x504c5245;  // "ERLP"
+    static const size_t MAX_LOADED_PARTITIONS = 512;
+
+    std::string root;
+    std::map<int, ProjectRollups> projects;
+    int64_t last_checkpoint;
+    int64_t last_flush[ROLLUP_LEVELS];
+    size_t loaded_partitions;
+    uint64_t use_clock;
+
+    static int64_t floor_to(int64_t ts, int64_t width) {
+        return ts - ((ts % width) + width) % width;
+    }
+
+    static int64_t flush_seconds(RollupLevel level) {
+        switch (level) {
+            case ROLLUP_MINUTE: return 60;
+            case ROLLUP_HOUR:   return 600;
+            default:            return 3600;
+        }
+    }
+
+    static bool parse_int(const std::string& s, int64_t& out) {
+        auto result = std::from_chars(s.data(), s.data() + s.size(), out);
+        return result.ec == std::errc() && result.ptr == s.data() + s.size() && !s.empty();
+    }
+
+    static int64_t partition_seconds(RollupLevel level) {
+        switch (level) {
+            case ROLLUP_MINUTE: return 3600;
+            case ROLLUP_HOUR:   return 86400;
+            default:            return 30 * 86400;
+        }
+    }
+
+    std::string project_dir(int project_id) const {
+        return root + "/p" + std::to_string(project_id);
+    }
+
+    std::string partition_path(int project_id, RollupLevel level, int64_t start) const {
+        return project_dir(project_id) + "/" + level_name(level) + "/" + std::to_string(start);
+    }
+
+    bool load_partition(int project_id, RollupLevel level, int64_t start, Partition& part) {
+        part.loaded = true;
+        std::ifstream in(partition_path(project_id, level, start), std::ios::binary | std::ios::ate);
+        if (!in.is_open()) return false;
+        std::string data(static_cast<size_t>(in.tellg()), '\0');
+        in.seekg(0);
+        in.read(&data[0], data.size());
+
+        const char* p = data.data();
+        const char* end = p + data.size();
+        uint32_t magic = 0;
+        uint64_t applied, n;
+        if (data.size() < sizeof(magic)) return false;
+        memcpy(&magic, p, sizeof(magic));
+        p += sizeof(magic);
+        if (magic != PARTITION_MAGIC || !get_varint(p, end, applied) || !get_varint(p, end, n)) {
+            std::cerr << "[RollupStore] Corrupt partition " << partition_path(project_id, level, start) << std::endl;
+            return false;
+        }
+
+        for (uint64_t i = 0; i < n; i++) {
+            uint64_t offset, func_id;
+            RollupRow row;
+            if (!get_varint(p, end, offset) || !get_varint(p, end, func_id) ||
+                !get_varint(p, end, row.count) || !get_varint(p, end, row.sum) ||
+                !get_varint(p, end, row.min) || !get_varint(p, end, row.max) ||
+                !row.sketch.decode(p, end)) {
+                std::cerr << "[RollupStore] Truncated partition " << partition_path(project_id, level, start) << std::endl;
+                part.rows.clear();
+                return false;
+            }
+            part.rows[{start + static_cast<int64_t>(offset), static_cast<uint32_t>(func_id)}] = row;
+        }
+
+        // Partitions written before distinct counts existed end here
+        uint64_t buckets = 0;
+        if (p < end && !get_varint(p, end, buckets)) buckets = 0;
+        for (uint64_t i = 0; i < buckets; i++) {
+            uint64_t offset;
+            DistinctRow row;
+            if (!get_varint(p, end, offset) || !row.funcs.decode(p, end) || !row.versions.decode(p, end)) {
+                std::cerr << "[RollupStore] Truncated partition " << partition_path(project_id, level, start) << std::endl;
+                part.rows.clear();
+                part.distinct.clear();
+                return false;
+            }
+            part.distinct[start + static_cast<int64_t>(offset)] = row;
+        }
+        part.applied_id = static_cast<int>(applied);
+        return true;
+    }
+
+    // [magic:u32][applied_id:varint][rows:varint] then per row
+    // [bucket - start][func_id][count][sum][min][max] as varints + sketch,
+    // then [buckets:varint] and per bucket [bucket - start] + two HLLs
+    bool write_partition(int project_id, RollupLevel level, int64_t start, const Partition& part, int applied_id) {
+        std::string data(sizeof(PARTITION_MAGIC), '\0');
+        memcpy(&data[0], &PARTITION_MAGIC, sizeof(PARTITION_MAGIC));
+        put_varint(data, applied_id);
+        put_varint(data, part.rows.size());
+        for (const auto& r : part.rows) {
+            put_varint(data, r.first.first - start);
+            put_varint(data, r.first.second);
+            put_varint(data, r.second.count);
+            put_varint(data, r.second.sum);
+            put_varint(data, r.second.min);
+            put_varint(data, r.second.max);
+            r.second.sketch.encode(data);
+        }
+        put_varint(data, part.distinct.size());
+        for (const auto& d : part.distinct) {
+            put_varint(data, d.first - start);
+            d.second.funcs.encode(data);
+            d.second.versions.encode(data);
+        }
+
+        std::string path = partition_path(project_id, level, start);
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) return false;
+            out.write(data.data(), data.size());
+        }
+        std::filesystem::rename(tmp, path, ec);
+        return !ec;
+    }
+
+    bool write_applied(int project_id, int applied_id) {
+        std::string path = project_dir(project_id) + "/applied";
+        std::string tmp = path + ".tmp";
+        std::error_code ec;
+        std::filesystem::create_directories(project_dir(project_id), ec);
+        {
+            std::ofstream out(tmp, std::ios::trunc);
+            if (!out.is_open()) return false;
+            out << applied_id << "\n";
+        }
+        std::filesystem::rename(tmp, path, ec);
+        return !ec;
+    }
+
+    // Loads `part` if needed and marks it as just used.
+    Partition& use(int project_id, RollupLevel level, int64_t start, Partition& part) {
+        if (!part.loaded) {
+            load_partition(project_id, level, start, part);
+            loaded_partitions++;
+        }
+        part.last_used = ++use_clock;
+        return part;
+    }
+
+    Partition& partition(int project_id, RollupLevel level, int64_t start) {
+        return use(project_id, level, start, projects[project_id].partitions[level][start]);
+    }
+
+    // Unloads the least recently used clean partitions once too many are
+    // in memory, down to three quarters of the limit.
+    void evict() {
+        if (loaded_partitions <= MAX_LOADED_PARTITIONS) return;
+
+        std::vector<std::pair<uint64_t, Partition*>> clean;
+        for (auto& p : projects) {
+            for (int l = 0; l < ROLLUP_LEVELS; l++) {
+                for (auto& part : p.second.partitions[l]) {
+                    if (part.second.loaded && !part.second.dirty) {
+                        clean.push_back({part.second.last_used, &part.second});
+                    }
+                }
+            }
+        }
+        std::sort(clean.begin(), clean.end(), [](const std::pair<uint64_t, Partition*>& a,
+                                                  const std::pair<uint64_t, Partition*>& b) {
+            return a.first < b.first;
+        });
+
+        size_t target = MAX_LOADED_PARTITIONS * 3 / 4;
+        for (size_t i = 0; i < clean.size() && loaded_partitions > target; i++) {
+            Partition* part = clean[i].second;
+            part->rows.clear();
+            part->distinct.clear();
+            part->loaded = false;
+            loaded_partitions--;
+        }
+    }
+
+    // Writes the dirty partitions of the levels in `levels` and advances
+    // each project's applied id as far as the remaining dirty ones allow.
+    void flush_levels(const bool (&levels)[ROLLUP_LEVELS]) {
+        for (auto& p : projects) {
+            ProjectRollups& proj = p.second;
+            bool ok = true;
+            int applied = proj.last_id;
+            for (int l = 0; l < ROLLUP_LEVELS; l++) {
+                for (auto& part : proj.partitions[l]) {
+                    if (!part.second.dirty) continue;
+                    if (levels[l] && write_partition(p.first, (RollupLevel)l, part.first, part.second, proj.last_id)) {
+                        part.second.applied_id = proj.last_id;
+                        part.second.dirty = false;
+                        continue;
+                    }
+                    if (levels[l]) ok = false;
+                    applied = std::min(applied, part.second.first_dirty_id - 1);
+                }
+            }
+            if (!ok) {
+                std::cerr << "[RollupStore] Failed to flush rollups of project " << p.first << std::endl;
+            }
+            if (applied > proj.applied_id && write_applied(p.first, applied)) {
+                proj.applied_id = applied;
+            }
+        }
+    }
+
+    void load_catalog() {
+        size_t partitions = 0;
+        for (const auto& pdir : std::filesystem::directory_iterator(root)) {
+            std::string pname = pdir.path().filename().string();
+            int64_t project_id;
+            if (!pdir.is_directory() || pname.size() < 2 || pname[0] != 'p' ||
+                !parse_int(pname.substr(1), project_id) || project_id < INT32_MIN || project_id > INT32_MAX) {
+                continue;
+            }
+            ProjectRollups& proj = projects[static_cast<int>(project_id)];
+
+            std::ifstream applied(pdir.path() / "applied");
+            if (applied >> proj.applied_id) proj.last_id = proj.applied_id;
+
+            for (int l = 0; l < ROLLUP_LEVELS; l++) {
+                std::filesystem::path ldir = pdir.path() / level_name((RollupLevel)l);
+                if (!std::filesystem::is_directory(ldir)) continue;
+                for (const auto& f : std::filesystem::directory_iterator(ldir)) {
+                    std::string fname = f.path().filename().string();
+                    int64_t start;
+                    if (!f.is_regular_file() || !parse_int(fname, start)) continue;
+                    proj.partitions[l][start];
+                    partitions++;
+                }
+            }
+        }
+
+        std::cout << "[RollupStore] Found " << partitions << " partitions for "
+                  << projects.size() << " projects in " << root << std::endl;
+    }
+
+public:
+    RollupStore(const std::string& root_dir)
+        : root(root_dir), last_checkpoint(0), last_flush(), loaded_partitions(0), use_clock(0) {
+        std::error_code ec;
+        std::filesystem::create_directories(root, ec);
+        if (ec) {
+            throw std::runtime_error("Failed to create rollup directory: " + root);
+        }
+        load_catalog();
+    }
+
+    ~RollupStore() {
+        flush();
+    }
+
+    static const char* level_name(RollupLevel level) {
+        switch (level) {
+            case ROLLUP_MINUTE: return "1m";
+            case ROLLUP_HOUR:   return "1h";
+            default:            return "1d";
+        }
+    }
+
+    static int64_t bucket_seconds(RollupLevel level) {
+        switch (level) {
+            case ROLLUP_MINUTE: return 60;
+            case ROLLUP_HOUR:   return 3600;
+            default:            return 86400;
+        }
+    }
+
+    static bool parse_level(const std::string& name, RollupLevel& out) {
+        for (int l = 0; l < ROLLUP_LEVELS; l++) {
+            if (name == level_name((RollupLevel)l)) {
+                out = (RollupLevel)l;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Newest trace id whose rows are known to be on disk for every partition.
+    int applied_id(int project_id) const {
+        auto it = projects.find(project_id);
+        return it == projects.end() ? 0 : it->second.applied_id;
+    }
+
+    void add(int project_id, int id, int64_t ts, uint32_t func_id, uint32_t version_id, uint64_t duration) {
+        for (int l = 0; l < ROLLUP_LEVELS; l++) {
+            RollupLevel level = (RollupLevel)l;
+            Partition& part = partition(project_id, level, floor_to(ts, partition_seconds(level)));
+            if (id <= part.applied_id) continue;
+            int64_t bucket = floor_to(ts, bucket_seconds(level));
+            part.rows[{bucket, func_id}].add(duration);
+            part.distinct[bucket].add(func_id, version_id);
+            if (!part.dirty) part.first_dirty_id = id;
+            part.first_dirty_id = std::min(part.first_dirty_id, id);
+            part.dirty = true;
+        }
+        ProjectRollups& proj = projects[project_id];
+        proj.last_id = std::max(proj.last_id, id);
+    }
+
+    // Removes the buckets of `level` that start in [from, to]. Partitions
+    // left empty are deleted; the others are written on the next flush.
+    void clear(int project_id, RollupLevel level, int64_t from, int64_t to) {
+        auto p = projects.find(project_id);
+        if (p == projects.end()) return;
+
+        int64_t span = partition_seconds(level);
+        auto& parts = p->second.partitions[level];
+        for (auto it = parts.begin(); it != parts.end();) {
+            if (it->first > to || it->first + span <= from) {
+                ++it;
+                continue;
+            }
+            Partition& part = use(project_id, level, it->first, it->second);
+            part.rows.erase(part.rows.lower_bound({from, 0}), part.rows.upper_bound({to, UINT32_MAX}));
+            part.distinct.erase(part.distinct.lower_bound(from), part.distinct.upper_bound(to));
+            if (part.rows.empty() && part.distinct.empty()) {
+                std::error_code ec;
+                std::filesystem::remove(partition_path(project_id, level, it->first), ec);
+                loaded_partitions--;
+                it = parts.erase(it);
+                continue;
+            }
+            if (!part.dirty) part.first_dirty_id = part.applied_id + 1;
+            part.dirty = true;
+            ++it;
+        }
+    }
+
+    // Adds a row to one level whatever the partition already holds, to
+    // refill buckets emptied by clear().
+    void restore(int project_id, RollupLevel level, int64_t ts, uint32_t func_id, uint32_t version_id,
+                 uint64_t duration) {
+        Partition& part = partition(project_id, level, floor_to(ts, partition_seconds(level)));
+        int64_t bucket = floor_to(ts, bucket_seconds(level));
+        part.rows[{bucket, func_id}].add(duration);
+        part.distinct[bucket].add(func_id, version_id);
+        if (!part.dirty) part.first_dirty_id = part.applied_id + 1;
+        part.dirty = true;
+    }
+
+    // Writes the levels whose flush interval has passed, checked at most
+    // once per minute of ingest time.
+    void checkpoint(int64_t now) {
+        int64_t minute = floor_to(now, 60);
+        if (minute <= last_checkpoint) return;
+        last_checkpoint = minute;
+
+        bool levels[ROLLUP_LEVELS];
+        for (int l = 0; l < ROLLUP_LEVELS; l++) {
+            levels[l] = minute - last_flush[l] >= flush_seconds((RollupLevel)l);
+            if (levels[l]) last_flush[l] = minute;
+        }
+        flush_levels(levels);
+        evict();
+    }
+
+    void flush() {
+        bool levels[ROLLUP_LEVELS];
+        std::fill(levels, levels + ROLLUP_LEVELS, true);
+        flush_levels(levels);
+        evict();
+    }
+
+    // Visits the rows of buckets overlapping [from, to] in bucket order
+    // (then func_id order).
+    void scan(int project_id, RollupLevel level, int64_t from, int64_t to,
+              const std::function<void(int64_t, uint32_t, const RollupRow&)>& visit) {
+        auto p = projects.find(project_id);
+        if (p == projects.end()) return;
+
+        int64_t width = bucket_seconds(level);
+        int64_t span = partition_seconds(level);
+        int64_t first = from == INT64_MIN ? INT64_MIN : floor_to(from, width);
+        for (auto& part : p->second.partitions[level]) {
+            if (part.first > to || (from != INT64_MIN && part.first + span <= from)) continue;
+            use(project_id, level, part.first, part.second);
+            for (const auto& r : part.second.rows) {
+                if (r.first.first < first || r.first.first > to) continue;
+                visit(r.first.first, r.first.second, r.second);
+            }
+        }
+        evict();
+    }
+
+    // Visits the distinct-count sketches of buckets overlapping [from, to]
+    // in bucket order.
+    void scan_distinct(int project_id, RollupLevel level, int64_t from, int64_t to,
+                       const std::function<void(int64_t, const DistinctRow&)>& visit) {
+        auto p = projects.find(project_id);
+        if (p == projects.end()) return;
+
+        int64_t width = bucket_seconds(level);
+        int64_t span = partition_seconds(level);
+        int64_t first = from == INT64_MIN ? INT64_MIN : floor_to(from, width);
+        for (auto& part : p->second.partitions[level]) {
+            if (part.first > to || (from != INT64_MIN && part.first + span <= from)) continue;
+            use(project_id, level, part.first, part.second);
+            for (auto it = part.second.distinct.lower_bound(first); it != part.second.distinct.end() && it->first <= to; ++it) {
+                visit(it->first, it->second);
+            }
+        }
+        evict();
+    }
+};
@@ -0,0 +1,683 @@
+#pragma once
+#include "Models.hpp"
+#include "Codecs.hpp"
+#include "QuantileSketch.hpp"
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+
+enum SegmentColumn {
+    COL_ID = 0,
+    COL_TIMESTAMP,
+    COL_DURATION,
+    COL_RAM,
+    COL_FUNC_ID,
+    COL_VERSION_ID,
+    COL_COUNT
+};
+
+struct SegmentInfo {
+    int project_id;
+    int64_t hour;       // start of the hour this segment was opened for
+    int seq;            // > 0 only if a sealed segment already owned this hour
+    uint64_t rows;
+    int64_t min_ts;
+    int64_t max_ts;
+    bool sealed;
+    bool compressed;
+    std::string dir;
+
+    SegmentInfo() : project_id(0), hour(0), seq(0), rows(0), min_ts(0), max_ts(0),
+                    sealed(false), compressed(false) {}
+
+    bool overlaps(int64_t from, int64_t to) const {
+        return rows > 0 && max_ts >= from && min_ts <= to;
+    }
+};
+
+// Time-partitioned column store for traces. Each project gets one directory
+// of hourly segments, and each segment stores one flat file per column:
+//
+//   <root>/p<project>/h<hour>[.<seq>]/{id,ts,duration,ram,func_id,version_id}.col
+//
+// A project has at most one open segment taking appends. When a row for a
+// later hour arrives (or the hour passes) the open segment is sealed by
+// writing its meta file, after which it is immutable. Rows arriving late for
+// an already-sealed hour go into the open segment; per-segment min/max
+// timestamps keep window pruning correct.
+//
+// Sealing also compresses every column into <name>.cz with the smallest of
+// the Codecs.hpp encodings (delta-of-delta for timestamps and ids, frame of
+// reference bit-packing for durations/RAM, RLE for low-cardinality ids) and
+// removes the raw .col files.
+//
+// Every segment also carries latency sketches (QuantileSketch.hpp) for the
+// project, each function and each (function, version) pair: kept in memory
+// while the segment is open, written to <dir>/sketch when it is sealed, and
+// rebuilt from the columns if that file is missing or outdated. Sealed
+// segments' sketches are cached in an LRU bounded by bucket count, and the
+// sketch of each project's full history is kept up to date at append and
+// drop, so un-windowed percentiles read no segment at all.
+class SegmentStore {
+private:
+    struct SegmentMeta {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t rows;
+        int64_t min_ts;
+        int64_t max_ts;
+    };
+
+    struct OpenSegment {
+        std::pair<int64_t, int> key;
+        std::ofstream files[COL_COUNT];
+        SketchSet sketches;
+    };
+
+    struct CachedSketches {
+        SketchSet sketches;
+        size_t buckets;
+        std::list<std::string>::iterator lru;
+    };
+
+    static const uint32_t META_MAGIC = 0x47455345;  // "ESEG"
+    static const uint32_t META_VERSION_RAW = 1;
+    static const uint32_t META_VERSION = 2;  // columns stored as .cz
+    static const int64_t SEGMENT_SECONDS = 3600;
+    static const size_t SKETCH_CACHE_BUCKETS = 1 << 20;  // ~50 MB of sketch buckets
+
+    std::string root;
+    std::map<int, std::map<std::pair<int64_t, int>, SegmentInfo>> catalog;
+    std::map<int, OpenSegment*> open_segments;
+    mutable std::unordered_map<std::string, CachedSketches> sketch_cache;  // by segment dir
+    mutable std::list<std::string> sketch_lru;  // most recently used first
+    mutable size_t cached_buckets;
+    mutable std::map<int, LatencySketch> project_sketches;  // filled on first use
+    int64_t last_expiry_check;
+
+    static int64_t hour_of(int64_t ts) {
+        return ts - ((ts % SEGMENT_SECONDS) + SEGMENT_SECONDS) % SEGMENT_SECONDS;
+    }
+
+    static std::string segment_dir_name(int64_t hour, int seq) {
+        std::string name = "h" + std::to_string(hour);
+        if (seq > 0) name += "." + std::to_string(seq);
+        return name;
+    }
+
+    std::string column_path(const SegmentInfo& info, SegmentColumn column) const {
+        return info.dir + "/" + column_name(column) + ".col";
+    }
+
+    std::string compressed_path(const SegmentInfo& info, SegmentColumn column) const {
+        return info.dir + "/" + column_name(column) + ".cz";
+    }
+
+    std::string sketch_path(const SegmentInfo& info) const {
+        return info.dir + "/sketch";
+    }
+
+    static size_t bucket_count(const SketchSet& set) {
+        size_t n = set.all.bucket_counts().size();
+        for (const auto& f : set.funcs) n += f.second.bucket_counts().size();
+        for (const auto& fv : set.func_versions) n += fv.second.bucket_counts().size();
+        return n;
+    }
+
+    const SketchSet& cache_sketches(const std::string& dir, SketchSet&& set) const {
+        forget_sketches(dir);
+        sketch_lru.push_front(dir);
+        CachedSketches& cached = sketch_cache[dir];
+        cached.buckets = bucket_count(set);
+        cached.sketches = std::move(set);
+        cached.lru = sketch_lru.begin();
+        cached_buckets += cached.buckets;
+
+        // Keep at least the entry just added
+        while (cached_buckets > SKETCH_CACHE_BUCKETS && sketch_lru.size() > 1) {
+            std::string oldest = sketch_lru.back();
+            forget_sketches(oldest);
+        }
+        return cached.sketches;
+    }
+
+    void forget_sketches(const std::string& dir) const {
+        auto it = sketch_cache.find(dir);
+        if (it == sketch_cache.end()) return;
+        cached_buckets -= it->second.buckets;
+        sketch_lru.erase(it->second.lru);
+        sketch_cache.erase(it);
+    }
+
+    bool build_sketches(const SegmentInfo& info, SketchSet& out) const {
+        std::vector<uint64_t> durations;
+        std::vector<uint32_t> func_ids, version_ids;
+        if (!read_column(info, COL_DURATION, durations) || !read_column(info, COL_FUNC_ID, func_ids) ||
+            !read_column(info, COL_VERSION_ID, version_ids)) {
+            return false;
+        }
+
+        out = SketchSet();
+        size_t n = std::min(durations.size(), std::min(func_ids.size(), version_ids.size()));
+        for (size_t i = 0; i < n; i++) {
+            out.add(func_ids[i], version_ids[i], durations[i]);
+        }
+        return true;
+    }
+
+    bool write_sketches(const SegmentInfo& info, const SketchSet& sketches) {
+        std::string encoded;
+        sketches.encode(encoded);
+
+        std::string tmp = sketch_path(info) + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) return false;
+            out.write(encoded.data(), encoded.size());
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp, sketch_path(info), ec);
+        return !ec;
+    }
+
+    bool read_sketches(const SegmentInfo& info, SketchSet& out) const {
+        std::ifstream in(sketch_path(info), std::ios::binary | std::ios::ate);
+        if (!in.is_open()) return false;
+        std::string encoded(static_cast<size_t>(in.tellg()), '\0');
+        in.seekg(0);
+        in.read(&encoded[0], encoded.size());
+        return out.decode(encoded.data(), encoded.data() + encoded.size());
+    }
+
+    template <typename T>
+    bool compress_column(const SegmentInfo& info, SegmentColumn column, size_t& raw_bytes,
+                         size_t& packed_bytes) {
+        std::vector<T> values;
+        if (!read_raw_column(info, column, values)) return false;
+
+        std::string encoded = Codec::encode_column(values);
+        std::ofstream out(compressed_path(info, column), std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+        out.write(encoded.data(), encoded.size());
+
+        raw_bytes += values.size() * sizeof(T);
+        packed_bytes += encoded.size();
+        return out.good();
+    }
+
+    // Writes .cz files for every column, then flips the meta to the
+    // compressed version, then drops the raw files. A crash at any point
+    // leaves either the raw or the compressed set readable.
+    bool compress_segment(SegmentInfo& info) {
+        size_t raw_bytes = 0, packed_bytes = 0;
+        bool ok = compress_column<int32_t>(info, COL_ID, raw_bytes, packed_bytes) &&
+                  compress_column<int64_t>(info, COL_TIMESTAMP, raw_bytes, packed_bytes) &&
+                  compress_column<uint64_t>(info, COL_DURATION, raw_bytes, packed_bytes) &&
+                  compress_column<uint64_t>(info, COL_RAM, raw_bytes, packed_bytes) &&
+                  compress_column<uint32_t>(info, COL_FUNC_ID, raw_bytes, packed_bytes) &&
+                  compress_column<uint32_t>(info, COL_VERSION_ID, raw_bytes, packed_bytes);
+        if (!ok || !write_meta(info, META_VERSION)) {
+            std::cerr << "[SegmentStore] Failed to compress segment " << info.dir << std::endl;
+            return false;
+        }
+
+        info.compressed = true;
+        for (int c = 0; c < COL_COUNT; c++) {
+            std::error_code ec;
+            std::filesystem::remove(column_path(info, (SegmentColumn)c), ec);
+        }
+
+        std::cout << "[SegmentStore] Sealed " << info.dir << ": " << info.rows << " rows, "
+                  << raw_bytes << " -> " << packed_bytes << " bytes" << std::endl;
+        return true;
+    }
+
+    template <typename T>
+    bool read_raw_column(const SegmentInfo& info, SegmentColumn column, std::vector<T>& out) const {
+        std::ifstream in(column_path(info, column), std::ios::binary);
+        if (!in.is_open()) return info.rows == 0;
+
+        out.resize(info.rows);
+        in.read(reinterpret_cast<char*>(out.data()), info.rows * sizeof(T));
+        out.resize(in.gcount() / sizeof(T));
+        return out.size() == info.rows;
+    }
+
+    template <typename T>
+    static void write_value(std::ofstream& out, T value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    bool write_meta(const SegmentInfo& info, uint32_t version) {
+        SegmentMeta meta = {META_MAGIC, version, info.rows, info.min_ts, info.max_ts};
+        std::string tmp = info.dir + "/meta.tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) return false;
+            out.write(reinterpret_cast<const char*>(&meta), sizeof(meta));
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp, info.dir + "/meta", ec);
+        return !ec;
+    }
+
+    bool read_meta(const std::string& dir, SegmentMeta& meta) const {
+        std::ifstream in(dir + "/meta", std::ios::binary);
+        if (!in.is_open()) return false;
+        in.read(reinterpret_cast<char*>(&meta), sizeof(meta));
+        return in.gcount() == sizeof(meta) && meta.magic == META_MAGIC;
+    }
+
+    // Brings an unsealed segment left over from a previous run back to a
+    // consistent state: all columns cut to the shortest one, min/max
+    // recomputed from the timestamp column.
+    void recover_open_segment(SegmentInfo& info) {
+        uint64_t rows = UINT64_MAX;
+        for (int c = 0; c < COL_COUNT; c++) {
+            std::error_code ec;
+            uint64_t size = std::filesystem::file_size(column_path(info, (SegmentColumn)c), ec);
+            if (ec) size = 0;
+            rows = std::min<uint64_t>(rows, size / column_width((SegmentColumn)c));
+        }
+        for (int c = 0; c < COL_COUNT; c++) {
+            std::error_code ec;
+            std::filesystem::resize_file(column_path(info, (SegmentColumn)c),
+                                         rows * column_width((SegmentColumn)c), ec);
+        }
+
+        info.rows = rows;
+        std::vector<int64_t> ts;
+        read_column(info, COL_TIMESTAMP, ts);
+        if (!ts.empty()) {
+            auto mm = std::minmax_element(ts.begin(), ts.end());
+            info.min_ts = *mm.first;
+            info.max_ts = *mm.second;
+        }
+    }
+
+    void load_catalog() {
+        namespace fs = std::filesystem;
+        std::error_code ec;
+        size_t total = 0;
+
+        for (const auto& project_dir : fs::directory_iterator(root, ec)) {
+            std::string pname = project_dir.path().filename().string();
+            if (!project_dir.is_directory() || pname.size() < 2 || pname[0] != 'p') continue;
+            int project_id = std::atoi(pname.c_str() + 1);
+
+            for (const auto& seg_dir : fs::directory_iterator(project_dir.path(), ec)) {
+                std::string sname = seg_dir.path().filename().string();
+                if (!seg_dir.is_directory() || sname.size() < 2 || sname[0] != 'h') continue;
+
+                SegmentInfo info;
+                info.project_id = project_id;
+                info.hour = std::atoll(sname.c_str() + 1);
+                size_t dot = sname.find('.');
+                info.seq = dot == std::string::npos ? 0 : std::atoi(sname.c_str() + dot + 1);
+                info.dir = seg_dir.path().string();
+
+                SegmentMeta meta;
+                if (read_meta(info.dir, meta)) {
+                    info.rows = meta.rows;
+                    info.min_ts = meta.min_ts;
+                    info.max_ts = meta.max_ts;
+                    info.sealed = true;
+                    info.compressed = meta.version >= META_VERSION;
+                    if (!info.compressed) compress_segment(info);
+                    // Sketches are decoded on first use; only segments sealed
+                    // before they existed get theirs built here, once
+                    SketchSet sketches;
+                    if (!fs::exists(sketch_path(info)) && build_sketches(info, sketches)) {
+                        write_sketches(info, sketches);
+                    }
+                } else {
+                    recover_open_segment(info);
+                }
+
+                catalog[project_id][{info.hour, info.seq}] = info;
+                total++;
+            }
+        }
+
+        // Only the newest segment of a project may stay open
+        for (auto& p : catalog) {
+            if (p.second.empty()) continue;
+            auto newest = std::prev(p.second.end());
+            for (auto it = p.second.begin(); it != newest; ++it) {
+                if (!it->second.sealed) seal(it->second);
+            }
+        }
+
+        std::cout << "[SegmentStore] Loaded " << total << " segments for "
+                  << catalog.size() << " projects from " << root << std::endl;
+    }
+
+    bool seal(SegmentInfo& info, const SketchSet* sketches = nullptr) {
+        if (info.sealed) return true;
+        info.sealed = write_meta(info, META_VERSION_RAW);
+        if (!info.sealed) return false;
+
+        compress_segment(info);
+        forget_sketches(info.dir);
+        if (sketches) {
+            write_sketches(info, *sketches);
+        } else {
+            SketchSet built;
+            if (build_sketches(info, built)) write_sketches(info, built);
+        }
+        return true;
+    }
+
+    void close_open_segment(int project_id) {
+        auto it = open_segments.find(project_id);
+        if (it == open_segments.end()) return;
+
+        SegmentInfo& info = catalog[project_id][it->second->key];
+        for (auto& f : it->second->files) f.close();
+        seal(info, &it->second->sketches);
+
+        delete it->second;
+        open_segments.erase(it);
+    }
+
+    SegmentInfo& create_segment(int project_id, int64_t hour) {
+        auto& segments = catalog[project_id];
+        int seq = 0;
+        while (segments.count({hour, seq})) seq++;
+
+        SegmentInfo info;
+        info.project_id = project_id;
+        info.hour = hour;
+        info.seq = seq;
+        info.dir = root + "/p" + std::to_string(project_id) + "/" + segment_dir_name(hour, seq);
+
+        std::error_code ec;
+        std::filesystem::create_directories(info.dir, ec);
+        segments[{hour, seq}] = info;
+        return segments[{hour, seq}];
+    }
+
+    OpenSegment* open_writer(SegmentInfo& info) {
+        OpenSegment* open = new OpenSegment();
+        open->key = {info.hour, info.seq};
+        if (info.rows > 0) build_sketches(info, open->sketches);
+        forget_sketches(info.dir);
+        for (int c = 0; c < COL_COUNT; c++) {
+            open->files[c].open(column_path(info, (SegmentColumn)c), std::ios::binary | std::ios::app);
+        }
+        open_segments[info.project_id] = open;
+        return open;
+    }
+
+    // Returns the segment a row at `hour` should be appended to, sealing the
+    // current one first if the row starts a newer hour.
+    SegmentInfo& segment_for(int project_id, int64_t hour) {
+        auto it = open_segments.find(project_id);
+        if (it == open_segments.end()) {
+            auto& segments = catalog[project_id];
+            if (!segments.empty()) {
+                SegmentInfo& newest = std::prev(segments.end())->second;
+                if (!newest.sealed) {
+                    open_writer(newest);
+                    it = open_segments.find(project_id);
+                }
+            }
+        }
+
+        if (it != open_segments.end()) {
+            SegmentInfo& current = catalog[project_id][it->second->key];
+            if (hour <= current.hour) {
+                return current;
+            }
+            close_open_segment(project_id);
+        }
+
+        // Never open a segment behind the newest one, so catalog order stays
+        // the order segments were written in
+        auto& segments = catalog[project_id];
+        if (!segments.empty()) {
+            hour = std::max(hour, std::prev(segments.end())->first.first);
+        }
+
+        SegmentInfo& info = create_segment(project_id, hour);
+        open_writer(info);
+        return info;
+    }
+
+public:
+    SegmentStore(const std::string& root_dir) : root(root_dir), cached_buckets(0), last_expiry_check(0) {
+        std::error_code ec;
+        std::filesystem::create_directories(root, ec);
+        if (ec) {
+            throw std::runtime_error("Failed to create segment directory: " + root);
+        }
+        load_catalog();
+    }
+
+    ~SegmentStore() {
+        for (auto& p : open_segments) {
+            for (auto& f : p.second->files) f.close();
+            delete p.second;
+        }
+    }
+
+    static const char* column_name(SegmentColumn column) {
+        switch (column) {
+            case COL_ID:         return "id";
+            case COL_TIMESTAMP:  return "ts";
+            case COL_DURATION:   return "duration";
+            case COL_RAM:        return "ram";
+            case COL_FUNC_ID:    return "func_id";
+            case COL_VERSION_ID: return "version_id";
+            default:             return "unknown";
+        }
+    }
+
+    static size_t column_width(SegmentColumn column) {
+        switch (column) {
+            case COL_ID:         return sizeof(int32_t);
+            case COL_TIMESTAMP:  return sizeof(int64_t);
+            case COL_DURATION:   return sizeof(uint64_t);
+            case COL_RAM:        return sizeof(uint64_t);
+            case COL_FUNC_ID:    return sizeof(uint32_t);
+            case COL_VERSION_ID: return sizeof(uint32_t);
+            default:             return 1;
+        }
+    }
+
+    bool empty() const {
+        return catalog.empty();
+    }
+
+    // Set by stores that recorded their backfill in <root>/backfilled,
+    // before the caller kept a checkpoint of the newest stored trace.
+    bool backfilled() const {
+        return std::filesystem::exists(root + "/backfilled");
+    }
+
+    // Newest trace id in any segment, 0 if there is none.
+    int max_id() const {
+        int newest = 0;
+        std::vector<int32_t> ids;
+        for (const auto& p : catalog) {
+            for (auto it = p.second.rbegin(); it != p.second.rend(); ++it) {
+                if (!read_column(it->second, COL_ID, ids) || ids.empty()) continue;
+                newest = std::max(newest, ids.back());
+                break;
+            }
+        }
+        return newest;
+    }
+
+    // Collects the stored ids above `after_id`. Rows are appended in id
+    // order, so only the newest segments of each project are read.
+    void ids_after(int after_id, std::unordered_set<int>& out) const {
+        std::vector<int32_t> ids;
+        for (const auto& p : catalog) {
+            for (auto it = p.second.rbegin(); it != p.second.rend(); ++it) {
+                if (!read_column(it->second, COL_ID, ids) || ids.empty()) continue;
+                for (int32_t id : ids) {
+                    if (id > after_id) out.insert(id);
+                }
+                if (ids.front() <= after_id) break;
+            }
+        }
+    }
+
+    std::vector<int> projects() const {
+        std::vector<int> result;
+        for (const auto& p : catalog) result.push_back(p.first);
+        return result;
+    }
+
+    void append(const ExecTrace::TraceEntry& entry) {
+        int64_t ts = static_cast<int64_t>(entry.timestamp);
+        SegmentInfo& info = segment_for(entry.project_id, hour_of(ts));
+        OpenSegment* open = open_segments[entry.project_id];
+
+        write_value<int32_t>(open->files[COL_ID], entry.id);
+        write_value<int64_t>(open->files[COL_TIMESTAMP], ts);
+        write_value<uint64_t>(open->files[COL_DURATION], entry.duration);
+        write_value<uint64_t>(open->files[COL_RAM], entry.ram_usage);
+        write_value<uint32_t>(open->files[COL_FUNC_ID], entry.func_id);
+        write_value<uint32_t>(open->files[COL_VERSION_ID], entry.version_id);
+        for (auto& f : open->files) f.flush();
+        open->sketches.add(entry.func_id, entry.version_id, entry.duration);
+        auto loaded = project_sketches.find(entry.project_id);
+        if (loaded != project_sketches.end()) loaded->second.add(entry.duration);
+
+        info.min_ts = info.rows == 0 ? ts : std::min(info.min_ts, ts);
+        info.max_ts = info.rows == 0 ? ts : std::max(info.max_ts, ts);
+        info.rows++;
+    }
+
+    // Seals open segments whose hour has passed. Cheap to call on every
+    // ingest: it only does work once per hour boundary.
+    void seal_expired(int64_t now) {
+        int64_t current_hour = hour_of(now);
+        if (current_hour <= last_expiry_check) return;
+        last_expiry_check = current_hour;
+
+        std::vector<int> expired;
+        for (const auto& p : open_segments) {
+            if (p.second->key.first < current_hour) expired.push_back(p.first);
+        }
+        for (int project_id : expired) {
+            close_open_segment(project_id);
+        }
+
+        for (auto& p : catalog) {
+            for (auto& s : p.second) {
+                if (!s.second.sealed && s.second.hour < current_hour &&
+                    !open_segments.count(p.first)) {
+                    seal(s.second);
+                }
+            }
+        }
+    }
+
+    std::vector<SegmentInfo> segments(int project_id, int64_t from = INT64_MIN,
+                                      int64_t to = INT64_MAX) const {
+        std::vector<SegmentInfo> result;
+        auto p = catalog.find(project_id);
+        if (p == catalog.end()) return result;
+
+        for (const auto& s : p->second) {
+            if (s.second.overlaps(from, to)) result.push_back(s.second);
+        }
+        return result;
+    }
+
+    template <typename T>
+    bool read_column(const SegmentInfo& info, SegmentColumn column, std::vector<T>& out) const {
+        out.clear();
+        if (sizeof(T) != column_width(column)) return false;
+        if (!info.compressed) return read_raw_column(info, column, out);
+
+        std::ifstream in(compressed_path(info, column), std::ios::binary | std::ios::ate);
+        if (!in.is_open()) return false;
+        std::string encoded(static_cast<size_t>(in.tellg()), '\0');
+        in.seekg(0);
+        in.read(&encoded[0], encoded.size());
+
+        return Codec::decode(encoded.data(), encoded.size(), out) && out.size() == info.rows;
+    }
+
+    // Latency sketches of one segment. Sealed segments are read from disk
+    // and kept in the LRU cache; the open one is maintained at ingest. The
+    // reference is only valid until the next call.
+    const SketchSet& sketches(const SegmentInfo& info) const {
+        auto open = open_segments.find(info.project_id);
+        if (open != open_segments.end() && open->second->key == std::make_pair(info.hour, info.seq)) {
+            return open->second->sketches;
+        }
+
+        auto cached = sketch_cache.find(info.dir);
+        if (cached != sketch_cache.end()) {
+            sketch_lru.splice(sketch_lru.begin(), sketch_lru, cached->second.lru);
+            return cached->second.sketches;
+        }
+
+        SketchSet loaded;
+        if (!info.sealed || !read_sketches(info, loaded)) {
+            build_sketches(info, loaded);
+        }
+        return cache_sketches(info.dir, std::move(loaded));
+    }
+
+    // Latency of every row the project has in its segments. Merged from
+    // the segment sketches on first use and kept current by append().
+    LatencySketch project_sketch(int project_id) const {
+        auto it = project_sketches.find(project_id);
+        if (it != project_sketches.end()) return it->second;
+
+        LatencySketch merged;
+        auto p = catalog.find(project_id);
+        if (p != catalog.end()) {
+            for (const auto& s : p->second) {
+                if (s.second.rows > 0) merged.merge(sketches(s.second).all);
+            }
+        }
+        project_sketches[project_id] = merged;
+        return merged;
+    }
+
+    // Drops whole sealed segments that end before `before_ts`, calling
+    // `on_drop` with each one before its directory is removed.
+    size_t drop_before(int project_id, int64_t before_ts,
+                       const std::function<void(const SegmentInfo&)>& on_drop = nullptr) {
+        auto p = catalog.find(project_id);
+        if (p == catalog.end()) return 0;
+
+        size_t dropped = 0;
+        for (auto it = p->second.begin(); it != p->second.end();) {
+            const SegmentInfo& info = it->second;
+            if (info.sealed && info.max_ts < before_ts) {
+                if (on_drop) on_drop(info);
+                std::error_code ec;
+                std::filesystem::remove_all(info.dir, ec);
+                forget_sketches(info.dir);
+                it = p->second.erase(it);
+                dropped++;
+            } else {
+                ++it;
+            }
+        }
+
+        if (dropped > 0) project_sketches.erase(project_id);
+
+        std::cout << "[SegmentStore] Dropped " << dropped << " segments of project " << project_id
+                  << " older than " << before_ts << std::endl;
+        return dropped;
+    }
+};
@@ -0,0 +1,123 @@
+#pragma once
+#include "DiskManager.hpp"
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Slotted page layout:
+//   [slot_count:u16][free_end:u16][slot 0: offset u16, length u16][slot 1]...
+//   ... free space ...
+//   [record n-1]...[record 1][record 0]                         <- PAGE_SIZE
+// The slot directory grows up from the header and records grow down from
+// the end of the page, so variable-length records pack without padding.
+class SlottedPage {
+private:
+    char* data;
+
+    static const int HEADER_SIZE = 2 * sizeof(uint16_t);
+    static const int SLOT_SIZE = 2 * sizeof(uint16_t);
+
+    uint16_t read_u16(int offset) const {
+        uint16_t v;
+        memcpy(&v, data + offset, sizeof(v));
+        return v;
+    }
+
+    void write_u16(int offset, uint16_t v) {
+        memcpy(data + offset, &v, sizeof(v));
+    }
+
+    uint16_t free_end() const {
+        return read_u16(sizeof(uint16_t));
+    }
+
+public:
+    static const int MAX_RECORD_SIZE = PAGE_SIZE - HEADER_SIZE - SLOT_SIZE;
+
+    explicit SlottedPage(char* buffer) : data(buffer) {
+        // A zero-filled page (fresh allocation or a hole) reads as empty
+        if (free_end() == 0) {
+            init();
+        }
+    }
+
+    void init() {
+        memset(data, 0, PAGE_SIZE);
+        write_u16(0, 0);
+        write_u16(sizeof(uint16_t), PAGE_SIZE);
+    }
+
+    int slot_count() const {
+        return read_u16(0);
+    }
+
+    int free_space() const {
+        int used_front = HEADER_SIZE + slot_count() * SLOT_SIZE;
+        return free_end() - used_front;
+    }
+
+    bool can_fit(int length) const {
+        return free_space() >= length + SLOT_SIZE;
+    }
+
+    // Returns the new slot number, or -1 if the record does not fit.
+    int insert(const char* record, int length) {
+        if (length <= 0 || length > MAX_RECORD_SIZE || !can_fit(length)) {
+            return -1;
+        }
+
+        int slot = slot_count();
+        uint16_t offset = free_end() - length;
+        memcpy(data + offset, record, length);
+
+        int slot_pos = HEADER_SIZE + slot * SLOT_SIZE;
+        write_u16(slot_pos, offset);
+        write_u16(slot_pos + sizeof(uint16_t), length);
+
+        write_u16(0, slot + 1);
+        write_u16(sizeof(uint16_t), offset);
+        return slot;
+    }
+
+    const char* record(int slot, int& length) const {
+        if (slot < 0 || slot >= slot_count()) {
+            length = 0;
+            return nullptr;
+        }
+        int slot_pos = HEADER_SIZE + slot * SLOT_SIZE;
+        uint16_t offset = read_u16(slot_pos);
+        length = read_u16(slot_pos + sizeof(uint16_t));
+        if (offset + length > PAGE_SIZE) {
+            length = 0;
+            return nullptr;
+        }
+        return data + offset;
+    }
+
+    char* mutable_record(int slot, int& length) {
+        return const_cast<char*>(record(slot, length));
+    }
+};
+
+// LEB128 varints for the small integers that dominate trace records.
+inline void put_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+inline bool get_varint(const char*& p, const char* end, uint64_t& value) {
+    value = 0;
+    int shift = 0;
+    while (p < end && shift < 64) {
+        uint8_t byte = static_cast<uint8_t>(*p++);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+        shift += 7;
+    }
+    return false;
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <filesystem>
+
+enum DictKind {
+    DICT_FUNC = 0,
+    DICT_VERSION = 1
+};
+
+// Persistent per-project string dictionary. Each (project, kind) pair has
+// its own id space starting at 1; id 0 means "no string". The backing file
+// is an append-only log of
+//   [project_id:i32][kind:u8][id:u32][len:u16][bytes]
+// replayed on startup. A torn record at the tail is truncated away.
+class StringDictionary {
+private:
+    struct Table {
+        std::unordered_map<std::string, uint32_t> ids;
+        std::vector<std::string> strings;  // strings[id - 1]
+    };
+
+    std::string filename;
+    std::ofstream log_file;
+    std::unordered_map<uint64_t, Table> tables;
+    std::string empty;
+
+    static uint64_t table_key(int project_id, DictKind kind) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(project_id)) << 8) | kind;
+    }
+
+    void load() {
+        std::ifstream in(filename, std::ios::binary);
+        if (!in.is_open()) return;
+
+        size_t loaded = 0;
+        std::streamoff good_end = 0;
+        while (true) {
+            int32_t project_id;
+            uint8_t kind;
+            uint32_t id;
+            uint16_t len;
+            if (!in.read(reinterpret_cast<char*>(&project_id), sizeof(project_id))) break;
+            if (!in.read(reinterpret_cast<char*>(&kind), sizeof(kind))) break;
+            if (!in.read(reinterpret_cast<char*>(&id), sizeof(id))) break;
+            if (!in.read(reinterpret_cast<char*>(&len), sizeof(len))) break;
+
+            std::string value(len, '\0');
+            if (len > 0 && !in.read(&value[0], len)) break;
+
+            good_end = in.tellg();
+            Table& table = tables[table_key(project_id, static_cast<DictKind>(kind))];
+            if (id != table.strings.size() + 1) {
+                std::cerr << "[StringDictionary] Skipping out-of-order id " << id
+                          << " for project " << project_id << std::endl;
+                continue;
+            }
+            table.ids.emplace(value, id);
+            table.strings.push_back(std::move(value));
+            loaded++;
+        }
+        in.close();
+
+        // Drop a torn tail so new appends start on a record boundary
+        std::error_code ec;
+        if (std::filesystem::file_size(filename, ec) > static_cast<uintmax_t>(good_end) && !ec) {
+            std::filesystem::resize_file(filename, good_end, ec);
+            std::cerr << "[StringDictionary] Truncated torn record at offset " << good_end << std::endl;
+        }
+
+        std::cout << "[StringDictionary] Loaded " << loaded << " strings from " << filename << std::endl;
+    }
+
+public:
+    StringDictionary(const std::string& file) : filename(file) {
+        load();
+        log_file.open(filename, std::ios::binary | std::ios::app);
+        if (!log_file.is_open()) {
+            throw std::runtime_error("Failed to open dictionary file: " + filename);
+        }
+    }
+
+    uint32_t intern(int project_id, DictKind kind, const char* value) {
+        std::string key(value ? value : "");
+        if (key.empty()) return 0;
+
+        Table& table = tables[table_key(project_id, kind)];
+        auto it = table.ids.find(key);
+        if (it != table.ids.end()) {
+            return it->second;
+        }
+
+        uint32_t id = static_cast<uint32_t>(table.strings.size() + 1);
+        uint8_t kind_byte = static_cast<uint8_t>(kind);
+        uint16_t len = static_cast<uint16_t>(std::min<size_t>(key.size(), UINT16_MAX));
+        int32_t pid = project_id;
+
+        log_file.write(reinterpret_cast<const char*>(&pid), sizeof(pid));
+        log_file.write(reinterpret_cast<const char*>(&kind_byte), sizeof(kind_byte));
+        log_file.write(reinterpret_cast<const char*>(&id), sizeof(id));
+        log_file.write(reinterpret_cast<const char*>(&len), sizeof(len));
+        log_file.write(key.data(), len);
+        log_file.flush();
+
+        table.ids.emplace(key, id);
+        table.strings.push_back(std::move(key));
+        return id;
+    }
+
+    bool lookup(int project_id, DictKind kind, const std::string& value, uint32_t& out_id) const {
+        auto t = tables.find(table_key(project_id, kind));
+        if (t == tables.end()) return false;
+
+        auto it = t->second.ids.find(value);
+        if (it == t->second.ids.end()) return false;
+
+        out_id = it->second;
+        return true;
+    }
+
+    const std::string& resolve(int project_id, DictKind kind, uint32_t id) const {
+        auto t = tables.find(table_key(project_id, kind));
+        if (t == tables.end() || id == 0 || id > t->second.strings.size()) {
+            return empty;
+        }
+        return t->second.strings[id - 1];
+    }
+
+    size_t size(int project_id, DictKind kind) const {
+        auto t = tables.find(table_key(project_id, kind));
+        return t == tables.end() ? 0 : t->second.strings.size();
+    }
+
+    // Projects that have at least one string of `kind`.
+    std::vector<int> projects(DictKind kind) const {
+        std::vector<int> out;
+        for (const auto& t : tables) {
+            if ((t.first & 0xff) == kind && !t.second.strings.empty()) {
+                out.push_back(static_cast<int32_t>(static_cast<uint32_t>(t.first >> 8)));
+            }
+        }
+        std::sort(out.begin(), out.end());
+        return out;
+    }
+};
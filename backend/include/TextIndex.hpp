@@ -0,0 +1,261 @@
+#pragma once
+#include "SlottedPage.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <string>
+#include <vector>
+
+// A trace as referenced from a trigram index: enough to fetch and order it.
+struct TextDoc {
+    int64_t timestamp;
+    int32_t id;
+    int32_t page_id;
+    int32_t slot;
+};
+
+// Case-insensitive trigram index over trace messages, one file per sealed
+// segment (`<segment dir>/trigrams`), for projects that opted in:
+//
+//   [magic:u32][docs:u32][trigrams:u32]
+//   [directory: trigrams x (trigram:u32, offset:u32, count:u32)]   sorted by trigram
+//   [docs: docs x (timestamp:i64, id:i32, page_id:i32, slot:i32)]  in (ts, id) order
+//   [postings: per trigram, ascending doc numbers as varint deltas]
+//
+// A lookup binary-searches the directory on disk and reads only the posting
+// lists of the query's trigrams, so the cost depends on how selective the
+// query is, not on the segment's size. Matches are candidates: the caller
+// checks the message itself. The enabled projects are listed one per line
+// in `path`.
+class TextIndex {
+private:
+    static const uint32_t MAGIC = 0x47545445;  // "ETTG"
+    static const size_t HEADER_BYTES = 12;
+    static const size_t ENTRY_BYTES = 12;
+    static const size_t DOC_BYTES = 20;
+
+    std::string path;
+    std::set<int> enabled_projects;
+
+    bool save() const {
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::trunc);
+            if (!out.is_open()) return false;
+            for (int project_id : enabled_projects) out << project_id << "\n";
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp, path, ec);
+        return !ec;
+    }
+
+    template <typename T>
+    static void put(std::string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    static bool read_at(std::ifstream& in, uint64_t offset, T& value) {
+        in.seekg(static_cast<std::streamoff>(offset));
+        in.read(reinterpret_cast<char*>(&value), sizeof(value));
+        return in.good();
+    }
+
+public:
+    TextIndex(const std::string& catalog_path) : path(catalog_path) {
+        std::ifstream in(path);
+        int project_id;
+        while (in >> project_id) enabled_projects.insert(project_id);
+        std::cout << "[TextIndex] Message search enabled for " << enabled_projects.size() << " projects" << std::endl;
+    }
+
+    bool enabled(int project_id) const {
+        return enabled_projects.count(project_id) > 0;
+    }
+
+    bool set_enabled(int project_id, bool on) {
+        if (on) {
+            enabled_projects.insert(project_id);
+        } else {
+            enabled_projects.erase(project_id);
+        }
+        return save();
+    }
+
+    std::vector<int> projects() const {
+        return std::vector<int>(enabled_projects.begin(), enabled_projects.end());
+    }
+
+    static std::string file_in(const std::string& segment_dir) {
+        return segment_dir + "/trigrams";
+    }
+
+    static uint32_t trigram_at(const char* p) {
+        return (static_cast<uint32_t>(tolower(static_cast<unsigned char>(p[0]))) << 16) |
+               (static_cast<uint32_t>(tolower(static_cast<unsigned char>(p[1]))) << 8) |
+               static_cast<uint32_t>(tolower(static_cast<unsigned char>(p[2])));
+    }
+
+    // Distinct lowercased trigrams of `text`, sorted.
+    static void trigrams(const std::string& text, std::vector<uint32_t>& out) {
+        out.clear();
+        for (size_t i = 0; i + 3 <= text.size(); i++) out.push_back(trigram_at(text.data() + i));
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    }
+
+    // Case-insensitive substring test; `needle` must already be lowercase.
+    static bool contains(const char* text, const std::string& needle) {
+        size_t n = strlen(text);
+        if (needle.size() > n) return false;
+        for (size_t i = 0; i + needle.size() <= n; i++) {
+            size_t j = 0;
+            while (j < needle.size() && tolower(static_cast<unsigned char>(text[i + j])) == needle[j]) j++;
+            if (j == needle.size()) return true;
+        }
+        return false;
+    }
+
+    // Writes the index of one segment; docs[i] has message messages[i].
+    static bool write(const std::string& file, const std::vector<TextDoc>& docs,
+                      const std::vector<std::string>& messages) {
+        std::vector<std::pair<uint32_t, uint32_t>> pairs;  // (trigram, doc)
+        std::vector<uint32_t> grams;
+        for (size_t d = 0; d < docs.size(); d++) {
+            trigrams(messages[d], grams);
+            for (uint32_t g : grams) pairs.push_back({g, static_cast<uint32_t>(d)});
+        }
+        std::sort(pairs.begin(), pairs.end());
+
+        std::string directory, postings;
+        for (size_t i = 0; i < pairs.size();) {
+            uint32_t gram = pairs[i].first;
+            uint32_t offset = static_cast<uint32_t>(postings.size());
+            uint32_t count = 0, prev = 0;
+            for (; i < pairs.size() && pairs[i].first == gram; i++, count++) {
+                put_varint(postings, pairs[i].second - prev);
+                prev = pairs[i].second;
+            }
+            put(directory, gram);
+            put(directory, offset);
+            put(directory, count);
+        }
+
+        std::string data;
+        put(data, MAGIC);
+        put(data, static_cast<uint32_t>(docs.size()));
+        put(data, static_cast<uint32_t>(directory.size() / ENTRY_BYTES));
+        data += directory;
+        for (const auto& doc : docs) {
+            put(data, doc.timestamp);
+            put(data, doc.id);
+            put(data, doc.page_id);
+            put(data, doc.slot);
+        }
+        data += postings;
+
+        std::string tmp = file + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) return false;
+            out.write(data.data(), data.size());
+            if (!out.good()) return false;
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp, file, ec);
+        return !ec;
+    }
+
+    // Docs of `file` containing every trigram of `grams` (sorted, distinct),
+    // in (ts, id) order. False if the file is missing or unreadable.
+    static bool candidates(const std::string& file, const std::vector<uint32_t>& grams, std::vector<TextDoc>& out) {
+        out.clear();
+        std::ifstream in(file, std::ios::binary | std::ios::ate);
+        if (!in.is_open()) return false;
+        uint64_t file_size = static_cast<uint64_t>(in.tellg());
+
+        uint32_t magic = 0, docs = 0, entries = 0;
+        if (!read_at(in, 0, magic) || !read_at(in, 4, docs) || !read_at(in, 8, entries) || magic != MAGIC) {
+            std::cerr << "[TextIndex] Corrupt index " << file << std::endl;
+            return false;
+        }
+        uint64_t docs_start = HEADER_BYTES + static_cast<uint64_t>(entries) * ENTRY_BYTES;
+        uint64_t postings_start = docs_start + static_cast<uint64_t>(docs) * DOC_BYTES;
+        if (postings_start > file_size) return false;
+
+        // Directory entry (offset, count, byte length) of each trigram
+        struct Posting {
+            uint32_t offset;
+            uint32_t count;
+            uint32_t bytes;
+        };
+        std::vector<Posting> lists;
+        for (uint32_t gram : grams) {
+            uint32_t lo = 0, hi = entries;
+            while (lo < hi) {
+                uint32_t mid = lo + (hi - lo) / 2;
+                uint32_t key = 0;
+                if (!read_at(in, HEADER_BYTES + static_cast<uint64_t>(mid) * ENTRY_BYTES, key)) return false;
+                if (key < gram) lo = mid + 1; else hi = mid;
+            }
+            uint32_t key = 0;
+            if (lo == entries || !read_at(in, HEADER_BYTES + static_cast<uint64_t>(lo) * ENTRY_BYTES, key) || key != gram) {
+                return true;  // some trigram never occurs
+            }
+            Posting p;
+            uint64_t entry = HEADER_BYTES + static_cast<uint64_t>(lo) * ENTRY_BYTES;
+            uint32_t next_offset = static_cast<uint32_t>(file_size - postings_start);
+            if (!read_at(in, entry + 4, p.offset) || !read_at(in, entry + 8, p.count)) return false;
+            if (lo + 1 < entries && !read_at(in, entry + ENTRY_BYTES + 4, next_offset)) return false;
+            p.bytes = next_offset - p.offset;
+            lists.push_back(p);
+        }
+
+        // Intersect starting from the shortest list
+        std::sort(lists.begin(), lists.end(), [](const Posting& a, const Posting& b) { return a.count < b.count; });
+        std::vector<uint32_t> matches, decoded, kept;
+        for (size_t l = 0; l < lists.size(); l++) {
+            std::string bytes(lists[l].bytes, '\0');
+            in.seekg(static_cast<std::streamoff>(postings_start + lists[l].offset));
+            in.read(&bytes[0], bytes.size());
+            if (!in.good()) return false;
+
+            decoded.clear();
+            const char* p = bytes.data();
+            const char* end = p + bytes.size();
+            uint64_t doc = 0, delta;
+            for (uint32_t i = 0; i < lists[l].count && get_varint(p, end, delta); i++) {
+                doc += delta;
+                decoded.push_back(static_cast<uint32_t>(doc));
+            }
+
+            if (l == 0) {
+                matches.swap(decoded);
+            } else {
+                kept.clear();
+                std::set_intersection(matches.begin(), matches.end(), decoded.begin(), decoded.end(),
+                                      std::back_inserter(kept));
+                matches.swap(kept);
+            }
+            if (matches.empty()) return true;
+        }
+
+        for (uint32_t d : matches) {
+            if (d >= docs) break;
+            TextDoc doc;
+            uint64_t at = docs_start + static_cast<uint64_t>(d) * DOC_BYTES;
+            if (!read_at(in, at, doc.timestamp) || !read_at(in, at + 8, doc.id) ||
+                !read_at(in, at + 12, doc.page_id) || !read_at(in, at + 16, doc.slot)) {
+                return false;
+            }
+            out.push_back(doc);
+        }
+        return true;
+    }
+};
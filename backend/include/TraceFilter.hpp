@@ -0,0 +1,487 @@
+#pragma once
+#include "Models.hpp"
+#include "StringDictionary.hpp"
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum FilterField {
+    FIELD_DURATION,
+    FIELD_RAM,
+    FIELD_TS,
+    FIELD_ID,
+    FIELD_FUNC,
+    FIELD_VERSION,
+    FIELD_MESSAGE
+};
+
+enum FilterOp {
+    FILTER_EQ,
+    FILTER_NE,
+    FILTER_LT,
+    FILTER_LE,
+    FILTER_GT,
+    FILTER_GE,
+    FILTER_CONTAINS,      // ~
+    FILTER_NOT_CONTAINS,  // !~
+    FILTER_IN,
+    FILTER_AND,
+    FILTER_OR,
+    FILTER_NOT
+};
+
+// One node of a compiled filter. Leaves compare `field` with `numbers` or
+// `texts`; AND/OR/NOT combine the nodes at `left` and `right`.
+struct FilterNode {
+    FilterOp op;
+    FilterField field;
+    std::vector<int64_t> numbers;
+    std::vector<std::string> texts;
+    int left;
+    int right;
+
+    FilterNode() : op(FILTER_AND), field(FIELD_ID), left(-1), right(-1) {}
+};
+
+// Trace filter expressions for /query/advanced, e.g.
+//
+//   duration > 250 and func ~ "db::" and version in ("v2","v3") and ts > now-1h
+//
+// Fields: duration (ms; units ms/s/m/h), ram (bytes; units kb/mb), ts (epoch
+// seconds or now[-+]<n>[s|m|h|d]), id, func, version and message. Operators:
+// = != < <= > >= on numbers, = != ~ (contains) !~ on strings, `in (...)` on
+// both, combined with and/or/not and parentheses.
+//
+// An expression is parsed once per query. func/version predicates are then
+// bound per project to sorted dictionary ids, so matching a row compares
+// integers; only message predicates look at text.
+class TraceFilter {
+private:
+    struct Token {
+        enum Kind { END, WORD, NUMBER, STRING, SYMBOL } kind;
+        std::string text;  // lowercased word, unit of a number, or symbol
+        std::string raw;   // as written
+        int64_t number;
+    };
+
+    std::vector<FilterNode> nodes;
+    int root;
+
+    // Dictionary ids matched by each func/version leaf, for one project
+    mutable std::unordered_map<int, std::vector<std::vector<uint32_t>>> bound;
+    mutable int bound_project;
+    mutable const std::vector<std::vector<uint32_t>>* bound_ids;
+
+    // Parser state
+    std::string input;
+    size_t pos;
+    Token token;
+    int64_t now;
+    std::string error;
+
+    static std::string lower(std::string s) {
+        for (auto& c : s) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        return s;
+    }
+
+    void next_token() {
+        while (pos < input.size() && isspace(static_cast<unsigned char>(input[pos]))) pos++;
+        token = Token{Token::END, "", "", 0};
+        if (pos >= input.size()) return;
+
+        char c = input[pos];
+        if (isdigit(static_cast<unsigned char>(c))) {
+            size_t start = pos;
+            while (pos < input.size() && isdigit(static_cast<unsigned char>(input[pos]))) pos++;
+            token.kind = Token::NUMBER;
+            token.number = std::stoll(input.substr(start, pos - start));
+            size_t unit = pos;
+            while (pos < input.size() && isalpha(static_cast<unsigned char>(input[pos]))) pos++;
+            token.text = lower(input.substr(unit, pos - unit));
+            token.raw = input.substr(start, pos - start);
+        } else if (isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            size_t start = pos;
+            while (pos < input.size() && (isalnum(static_cast<unsigned char>(input[pos])) || input[pos] == '_')) pos++;
+            token.kind = Token::WORD;
+            token.raw = input.substr(start, pos - start);
+            token.text = lower(token.raw);
+        } else if (c == '"' || c == '\'') {
+            pos++;
+            token.kind = Token::STRING;
+            while (pos < input.size() && input[pos] != c) {
+                if (input[pos] == '\\' && pos + 1 < input.size()) pos++;
+                token.raw += input[pos++];
+            }
+            token.text = token.raw;
+            if (pos >= input.size()) {
+                fail("Unterminated string");
+                return;
+            }
+            pos++;
+        } else {
+            static const char* symbols[] = {"!=", "<=", ">=", "!~", "==", "=", "<", ">", "~", "(", ")", ",", "-", "+"};
+            token.kind = Token::SYMBOL;
+            for (const char* s : symbols) {
+                if (input.compare(pos, strlen(s), s) == 0) {
+                    token.text = token.raw = s;
+                    pos += strlen(s);
+                    return;
+                }
+            }
+            fail(std::string("Unexpected character '") + c + "'");
+        }
+    }
+
+    void fail(const std::string& message) {
+        if (error.empty()) error = message;
+        token = Token{Token::END, "", "", 0};
+        pos = input.size();
+    }
+
+    bool accept_symbol(const char* s) {
+        if (token.kind == Token::SYMBOL && token.text == s) {
+            next_token();
+            return true;
+        }
+        return false;
+    }
+
+    bool accept_word(const char* w) {
+        if (token.kind == Token::WORD && token.text == w) {
+            next_token();
+            return true;
+        }
+        return false;
+    }
+
+    int add_node(const FilterNode& node) {
+        nodes.push_back(node);
+        return static_cast<int>(nodes.size()) - 1;
+    }
+
+    int combine(FilterOp op, int left, int right) {
+        FilterNode node;
+        node.op = op;
+        node.left = left;
+        node.right = right;
+        return add_node(node);
+    }
+
+    int parse_or() {
+        int left = parse_and();
+        while (error.empty() && accept_word("or")) left = combine(FILTER_OR, left, parse_and());
+        return left;
+    }
+
+    int parse_and() {
+        int left = parse_unary();
+        while (error.empty() && accept_word("and")) left = combine(FILTER_AND, left, parse_unary());
+        return left;
+    }
+
+    int parse_unary() {
+        if (accept_word("not")) return combine(FILTER_NOT, parse_unary(), -1);
+        if (accept_symbol("(")) {
+            int inner = parse_or();
+            if (!accept_symbol(")")) fail("Expected ')'");
+            return inner;
+        }
+        return parse_comparison();
+    }
+
+    static bool parse_field(const std::string& name, FilterField& out) {
+        static const std::pair<const char*, FilterField> fields[] = {
+            {"duration", FIELD_DURATION}, {"ram", FIELD_RAM}, {"ts", FIELD_TS}, {"timestamp", FIELD_TS},
+            {"id", FIELD_ID}, {"func", FIELD_FUNC}, {"version", FIELD_VERSION}, {"message", FIELD_MESSAGE}
+        };
+        for (const auto& f : fields) {
+            if (name == f.first) {
+                out = f.second;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool is_text(FilterField field) {
+        return field == FIELD_FUNC || field == FIELD_VERSION || field == FIELD_MESSAGE;
+    }
+
+    // Scales a number by its unit for `field`; false if the unit is unknown.
+    static bool apply_unit(FilterField field, const std::string& unit, int64_t& value) {
+        if (unit.empty()) return true;
+        if (field == FIELD_DURATION) {
+            if (unit == "ms") return true;
+            if (unit == "s") { value *= 1000; return true; }
+            if (unit == "m") { value *= 60000; return true; }
+            if (unit == "h") { value *= 3600000; return true; }
+        } else if (field == FIELD_RAM) {
+            if (unit == "b") return true;
+            if (unit == "kb") { value *= 1024; return true; }
+            if (unit == "mb") { value *= 1024 * 1024; return true; }
+        } else if (field == FIELD_TS) {
+            if (unit == "s") return true;
+            if (unit == "m") { value *= 60; return true; }
+            if (unit == "h") { value *= 3600; return true; }
+            if (unit == "d") { value *= 86400; return true; }
+        }
+        return false;
+    }
+
+    bool parse_value(FilterNode& node) {
+        if (is_text(node.field)) {
+            if (token.kind != Token::STRING && token.kind != Token::WORD) {
+                fail("Expected a string");
+                return false;
+            }
+            node.texts.push_back(token.raw);
+            next_token();
+            return true;
+        }
+
+        int64_t value = 0;
+        if (node.field == FIELD_TS && accept_word("now")) {
+            value = now;
+            bool minus = token.kind == Token::SYMBOL && token.text == "-";
+            if (accept_symbol("-") || accept_symbol("+")) {
+                int64_t offset = token.number;
+                if (token.kind != Token::NUMBER || !apply_unit(FIELD_TS, token.text, offset)) {
+                    fail("Expected an offset like 1h after now");
+                    return false;
+                }
+                next_token();
+                value += minus ? -offset : offset;
+            }
+        } else {
+            bool minus = accept_symbol("-");
+            value = token.number;
+            if (token.kind != Token::NUMBER || !apply_unit(node.field, token.text, value)) {
+                fail(token.kind == Token::NUMBER ? "Unknown unit: " + token.text : "Expected a number");
+                return false;
+            }
+            next_token();
+            if (minus) value = -value;
+        }
+        node.numbers.push_back(value);
+        return true;
+    }
+
+    int parse_comparison() {
+        FilterNode node;
+        if (token.kind != Token::WORD || !parse_field(token.text, node.field)) {
+            fail(token.kind == Token::END ? "Expected a field" : "Unknown field: " + token.text);
+            return -1;
+        }
+        next_token();
+
+        if (accept_word("in")) {
+            node.op = FILTER_IN;
+            if (!accept_symbol("(")) {
+                fail("Expected '(' after in");
+                return -1;
+            }
+            do {
+                if (!parse_value(node)) return -1;
+            } while (accept_symbol(","));
+            if (!accept_symbol(")")) fail("Expected ')'");
+            return add_node(node);
+        }
+
+        static const std::pair<const char*, FilterOp> ops[] = {
+            {"=", FILTER_EQ}, {"==", FILTER_EQ}, {"!=", FILTER_NE}, {"<", FILTER_LT}, {"<=", FILTER_LE},
+            {">", FILTER_GT}, {">=", FILTER_GE}, {"~", FILTER_CONTAINS}, {"!~", FILTER_NOT_CONTAINS}
+        };
+        bool found = false;
+        for (const auto& op : ops) {
+            if (token.kind == Token::SYMBOL && token.text == op.first) {
+                node.op = op.second;
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            fail("Expected an operator");
+            return -1;
+        }
+        bool ordering = node.op == FILTER_LT || node.op == FILTER_LE || node.op == FILTER_GT || node.op == FILTER_GE;
+        bool containment = node.op == FILTER_CONTAINS || node.op == FILTER_NOT_CONTAINS;
+        if (is_text(node.field) && ordering) {
+            fail("Strings only support =, !=, ~, !~ and in");
+            return -1;
+        }
+        if (!is_text(node.field) && containment) {
+            fail("~ and !~ only apply to func, version and message");
+            return -1;
+        }
+        next_token();
+        if (!parse_value(node)) return -1;
+        return add_node(node);
+    }
+
+    static int64_t number_of(FilterField field, const ExecTrace::TraceEntry& e) {
+        switch (field) {
+            case FIELD_DURATION: return static_cast<int64_t>(e.duration);
+            case FIELD_RAM:      return static_cast<int64_t>(e.ram_usage);
+            case FIELD_TS:       return static_cast<int64_t>(e.timestamp);
+            default:             return e.id;
+        }
+    }
+
+    const std::vector<std::vector<uint32_t>>& bind(int project_id, const StringDictionary& dict) const {
+        if (bound_ids && bound_project == project_id) return *bound_ids;
+
+        auto it = bound.find(project_id);
+        if (it == bound.end()) {
+            std::vector<std::vector<uint32_t>> ids(nodes.size());
+            for (size_t n = 0; n < nodes.size(); n++) {
+                const FilterNode& node = nodes[n];
+                if (node.field != FIELD_FUNC && node.field != FIELD_VERSION) continue;
+                if (node.op > FILTER_IN) continue;
+                DictKind kind = node.field == FIELD_FUNC ? DICT_FUNC : DICT_VERSION;
+                if (node.op == FILTER_CONTAINS || node.op == FILTER_NOT_CONTAINS) {
+                    uint32_t size = static_cast<uint32_t>(dict.size(project_id, kind));
+                    for (uint32_t id = 1; id <= size; id++) {
+                        if (dict.resolve(project_id, kind, id).find(node.texts[0]) != std::string::npos) {
+                            ids[n].push_back(id);
+                        }
+                    }
+                } else {
+                    for (const auto& text : node.texts) {
+                        uint32_t id;
+                        if (dict.lookup(project_id, kind, text, id)) ids[n].push_back(id);
+                    }
+                    std::sort(ids[n].begin(), ids[n].end());
+                }
+            }
+            it = bound.emplace(project_id, std::move(ids)).first;
+        }
+        bound_project = project_id;
+        bound_ids = &it->second;
+        return it->second;
+    }
+
+    bool eval(int n, const ExecTrace::TraceEntry& e, const std::vector<std::vector<uint32_t>>& ids) const {
+        const FilterNode& node = nodes[n];
+        switch (node.op) {
+            case FILTER_AND: return eval(node.left, e, ids) && eval(node.right, e, ids);
+            case FILTER_OR:  return eval(node.left, e, ids) || eval(node.right, e, ids);
+            case FILTER_NOT: return !eval(node.left, e, ids);
+            default: break;
+        }
+
+        if (node.field == FIELD_FUNC || node.field == FIELD_VERSION) {
+            uint32_t id = node.field == FIELD_FUNC ? e.func_id : e.version_id;
+            bool hit = std::binary_search(ids[n].begin(), ids[n].end(), id);
+            return node.op == FILTER_NE || node.op == FILTER_NOT_CONTAINS ? !hit : hit;
+        }
+
+        if (node.field == FIELD_MESSAGE) {
+            switch (node.op) {
+                case FILTER_EQ:           return node.texts[0] == e.message;
+                case FILTER_NE:           return node.texts[0] != e.message;
+                case FILTER_CONTAINS:     return strstr(e.message, node.texts[0].c_str()) != nullptr;
+                case FILTER_NOT_CONTAINS: return strstr(e.message, node.texts[0].c_str()) == nullptr;
+                default:
+                    return std::find(node.texts.begin(), node.texts.end(), e.message) != node.texts.end();
+            }
+        }
+
+        int64_t v = number_of(node.field, e);
+        switch (node.op) {
+            case FILTER_EQ: return v == node.numbers[0];
+            case FILTER_NE: return v != node.numbers[0];
+            case FILTER_LT: return v < node.numbers[0];
+            case FILTER_LE: return v <= node.numbers[0];
+            case FILTER_GT: return v > node.numbers[0];
+            case FILTER_GE: return v >= node.numbers[0];
+            default:
+                return std::find(node.numbers.begin(), node.numbers.end(), v) != node.numbers.end();
+        }
+    }
+
+    // Leaves joined to the root by AND only.
+    std::vector<int> conjuncts() const {
+        std::vector<int> leaves;
+        std::vector<int> stack;
+        if (root >= 0) stack.push_back(root);
+        while (!stack.empty()) {
+            int n = stack.back();
+            stack.pop_back();
+            if (nodes[n].op == FILTER_AND) {
+                stack.push_back(nodes[n].left);
+                stack.push_back(nodes[n].right);
+            } else if (nodes[n].op != FILTER_OR && nodes[n].op != FILTER_NOT) {
+                leaves.push_back(n);
+            }
+        }
+        return leaves;
+    }
+
+public:
+    TraceFilter() : root(-1), bound_project(0), bound_ids(nullptr), pos(0), now(0) {}
+
+    TraceFilter(const TraceFilter& other) : nodes(other.nodes), root(other.root),
+                                            bound_project(0), bound_ids(nullptr), pos(0), now(0) {}
+
+    TraceFilter& operator=(const TraceFilter&) = delete;
+
+    // Compiles `text`, with `now_ts` as the value of `now`. Returns an error
+    // message or an empty string; an empty expression matches everything.
+    std::string parse(const std::string& text, int64_t now_ts) {
+        nodes.clear();
+        bound.clear();
+        bound_ids = nullptr;
+        input = text;
+        pos = 0;
+        now = now_ts;
+        error.clear();
+
+        next_token();
+        root = token.kind == Token::END && error.empty() ? -1 : parse_or();
+        if (error.empty() && token.kind != Token::END) fail("Unexpected '" + token.raw + "'");
+        if (!error.empty()) {
+            nodes.clear();
+            root = -1;
+        }
+        input.clear();
+        return error;
+    }
+
+    bool empty() const { return root < 0; }
+
+    bool matches(const ExecTrace::TraceEntry& entry, const StringDictionary& dict) const {
+        if (root < 0) return true;
+        return eval(root, entry, bind(entry.project_id, dict));
+    }
+
+    // Narrows [from, to] by ts comparisons every match must satisfy.
+    void time_bounds(int64_t& from, int64_t& to) const {
+        for (int n : conjuncts()) {
+            const FilterNode& node = nodes[n];
+            if (node.field != FIELD_TS || node.op > FILTER_GE || node.op == FILTER_NE) continue;
+            int64_t v = node.numbers[0];
+            if (node.op == FILTER_EQ || node.op == FILTER_GE) from = std::max(from, v);
+            if (node.op == FILTER_GT && v < INT64_MAX) from = std::max(from, v + 1);
+            if (node.op == FILTER_EQ || node.op == FILTER_LE) to = std::min(to, v);
+            if (node.op == FILTER_LT && v > INT64_MIN) to = std::min(to, v - 1);
+        }
+    }
+
+    // If every match must have one of a known set of functions, fills
+    // `func_ids` with it (possibly empty) and returns true.
+    bool function_candidates(int project_id, const StringDictionary& dict, std::vector<uint32_t>& func_ids) const {
+        for (int n : conjuncts()) {
+            const FilterNode& node = nodes[n];
+            if (node.field != FIELD_FUNC) continue;
+            if (node.op == FILTER_EQ || node.op == FILTER_IN || node.op == FILTER_CONTAINS) {
+                func_ids = bind(project_id, dict)[n];
+                return true;
+            }
+        }
+        return false;
+    }
+};
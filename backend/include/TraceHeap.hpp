@@ -0,0 +1,473 @@
+#pragma once
+#include "SlottedPage.hpp"
+#include "BTree.hpp"
+#include "Models.hpp"
+#include <functional>
+#include <fstream>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+
+// On-disk layout of traces.db before the slotted heap: a BTree<TraceEntry>
+// with fixed 128/256/32 byte string fields. Kept frozen so old files can
+// still be read by the converter even as TraceEntry evolves.
+struct LegacyTraceEntry {
+    int id;
+    int project_id;
+    char func[128];
+    char message[256];
+    char app_version[32];
+    uint64_t duration;
+    uint64_t ram_usage;
+    time_t timestamp;
+    bool is_deleted;
+
+    bool operator<(const LegacyTraceEntry& other) const { return id < other.id; }
+    bool operator==(const LegacyTraceEntry& other) const { return id == other.id; }
+    bool operator>(const LegacyTraceEntry& other) const { return id > other.id; }
+};
+
+struct RecordId {
+    int page_id;
+    int slot;
+
+    RecordId() : page_id(0), slot(-1) {}
+    RecordId(int page, int s) : page_id(page), slot(s) {}
+
+    bool is_valid() const {
+        return page_id > 0 && slot >= 0;
+    }
+};
+
+// Variable-length trace record:
+//   [flags:u8][id:i32][project_id:i32][timestamp:i64]
+//   [duration:varint][ram:varint]
+//   FLAG_DICT set:   [func_id:varint][version_id:varint]
+//   FLAG_DICT clear: [func_len:u8][func][version_len:u8][version]
+//   [message_len:u8][message]
+// Dictionary-encoded records leave func/app_version empty on decode; the
+// caller resolves the ids through StringDictionary when it needs the text.
+namespace TraceRecord {
+
+const uint8_t FLAG_DELETED = 0x01;
+const uint8_t FLAG_DICT = 0x02;
+const int ID_OFFSET = 1;
+
+inline void append_string(std::string& out, const char* s, size_t max_len) {
+    size_t len = strnlen(s, max_len);
+    if (len > 255) len = 255;
+    out += static_cast<char>(len);
+    out.append(s, len);
+}
+
+inline bool read_string(const char*& p, const char* end, char* dest, size_t dest_size) {
+    if (p >= end) return false;
+    size_t len = static_cast<uint8_t>(*p++);
+    if (p + len > end) return false;
+
+    size_t copy = std::min(len, dest_size - 1);
+    memset(dest, 0, dest_size);
+    memcpy(dest, p, copy);
+    p += len;
+    return true;
+}
+
+inline void encode(const ExecTrace::TraceEntry& entry, std::string& out) {
+    out.clear();
+    out.reserve(32 + sizeof(entry.func) / 4 + sizeof(entry.message) / 4);
+
+    bool dict = entry.func_id != 0;
+    uint8_t flags = (entry.is_deleted ? FLAG_DELETED : 0) | (dict ? FLAG_DICT : 0);
+    int64_t ts = static_cast<int64_t>(entry.timestamp);
+
+    out += static_cast<char>(flags);
+    out.append(reinterpret_cast<const char*>(&entry.id), sizeof(int32_t));
+    out.append(reinterpret_cast<const char*>(&entry.project_id), sizeof(int32_t));
+    out.append(reinterpret_cast<const char*>(&ts), sizeof(int64_t));
+    put_varint(out, entry.duration);
+    put_varint(out, entry.ram_usage);
+    if (dict) {
+        put_varint(out, entry.func_id);
+        put_varint(out, entry.version_id);
+    } else {
+        append_string(out, entry.func, sizeof(entry.func));
+        append_string(out, entry.app_version, sizeof(entry.app_version));
+    }
+    append_string(out, entry.message, sizeof(entry.message));
+}
+
+inline bool decode(const char* data, int length, ExecTrace::TraceEntry& entry) {
+    const char* p = data;
+    const char* end = data + length;
+    const int fixed = 1 + 2 * sizeof(int32_t) + sizeof(int64_t);
+    if (length < fixed) return false;
+
+    uint8_t flags = static_cast<uint8_t>(*p++);
+    int64_t ts;
+    memcpy(&entry.id, p, sizeof(int32_t));
+    p += sizeof(int32_t);
+    memcpy(&entry.project_id, p, sizeof(int32_t));
+    p += sizeof(int32_t);
+    memcpy(&ts, p, sizeof(int64_t));
+    p += sizeof(int64_t);
+
+    entry.timestamp = static_cast<time_t>(ts);
+    entry.is_deleted = (flags & FLAG_DELETED) != 0;
+
+    if (!get_varint(p, end, entry.duration)) return false;
+    if (!get_varint(p, end, entry.ram_usage)) return false;
+
+    if (flags & FLAG_DICT) {
+        uint64_t func_id, version_id;
+        if (!get_varint(p, end, func_id) || !get_varint(p, end, version_id)) return false;
+        entry.func_id = static_cast<uint32_t>(func_id);
+        entry.version_id = static_cast<uint32_t>(version_id);
+        entry.func[0] = '\0';
+        entry.app_version[0] = '\0';
+    } else {
+        entry.func_id = 0;
+        entry.version_id = 0;
+        if (!read_string(p, end, entry.func, sizeof(entry.func)) ||
+            !read_string(p, end, entry.app_version, sizeof(entry.app_version))) {
+            return false;
+        }
+    }
+
+    return read_string(p, end, entry.message, sizeof(entry.message));
+}
+
+inline int peek_id(const char* data, int length) {
+    if (length < ID_OFFSET + (int)sizeof(int32_t)) return 0;
+    int id;
+    memcpy(&id, data + ID_OFFSET, sizeof(int32_t));
+    return id;
+}
+
+}
+
+// Append-only heap of slotted pages. Page 0 is a superblock holding the
+// format magic; pages 1..N hold trace records in ascending id order, which
+// lets lookups by id binary-search pages instead of walking a tree.
+class TraceHeap {
+private:
+    DiskManager* dm;
+    int tail_page_id;
+    char tail[PAGE_SIZE];
+    char cached_page[PAGE_SIZE];
+    int cached_page_id;
+    int max_id;
+
+    static const uint32_t MAGIC = 0x50485445;  // "ETHP"
+    static const uint32_t FORMAT_VERSION = 1;
+
+    void write_superblock() {
+        char buffer[PAGE_SIZE];
+        memset(buffer, 0, PAGE_SIZE);
+        memcpy(buffer, &MAGIC, sizeof(MAGIC));
+        memcpy(buffer + sizeof(MAGIC), &FORMAT_VERSION, sizeof(FORMAT_VERSION));
+        dm->write_page(0, buffer);
+    }
+
+    int first_id_on_page(int page_id) {
+        char buffer[PAGE_SIZE];
+        dm->read_page(page_id, buffer);
+        SlottedPage page(buffer);
+        int length;
+        const char* rec = page.record(0, length);
+        return rec ? TraceRecord::peek_id(rec, length) : 0;
+    }
+
+    // Last page whose first record has an id <= `id`, or 0 if none.
+    int page_of(int id) {
+        int lo = 1, hi = dm->page_count() - 1, target = 0;
+        while (lo <= hi) {
+            int mid = lo + (hi - lo) / 2;
+            int first = first_id_on_page(mid);
+            if (first != 0 && first <= id) {
+                target = mid;
+                lo = mid + 1;
+            } else {
+                hi = mid - 1;
+            }
+        }
+        return target;
+    }
+
+public:
+    TraceHeap(const std::string& filename) : tail_page_id(0), cached_page_id(0), max_id(0) {
+        std::error_code ec;
+        uintmax_t file_size = std::filesystem::file_size(filename, ec);
+        bool fresh = ec || file_size == 0;
+
+        dm = new DiskManager(filename);
+
+        char buffer[PAGE_SIZE];
+        dm->read_page(0, buffer);
+        uint32_t magic;
+        memcpy(&magic, buffer, sizeof(magic));
+
+        if (magic != MAGIC) {
+            // Only a brand new file gets a superblock; anything else may be
+            // data we do not understand and must not be overwritten.
+            if (!fresh) {
+                delete dm;
+                throw std::runtime_error("Not a trace heap file: " + filename);
+            }
+            write_superblock();
+        }
+
+        int pages = dm->page_count();
+        if (pages > 1) {
+            tail_page_id = pages - 1;
+            dm->read_page(tail_page_id, tail);
+
+            // The tail may be empty if we stopped right after allocating it
+            for (int page_id = tail_page_id; page_id > 0 && max_id == 0; page_id--) {
+                dm->read_page(page_id, buffer);
+                SlottedPage page(buffer);
+                for (int slot = 0; slot < page.slot_count(); slot++) {
+                    int length;
+                    const char* rec = page.record(slot, length);
+                    if (rec) {
+                        max_id = std::max(max_id, TraceRecord::peek_id(rec, length));
+                    }
+                }
+            }
+        } else {
+            tail_page_id = dm->allocate_page();
+            SlottedPage page(tail);
+            page.init();
+            dm->write_page(tail_page_id, tail);
+        }
+
+        std::cout << "[TraceHeap] Opened " << filename << " (" << (dm->page_count() - 1)
+                  << " data pages, max id " << max_id << ")" << std::endl;
+    }
+
+    ~TraceHeap() {
+        delete dm;
+    }
+
+    // True if the file exists and holds data in the pre-heap BTree format.
+    static bool is_legacy_file(const std::string& filename) {
+        std::ifstream in(filename, std::ios::binary);
+        if (!in.is_open()) return false;
+
+        char header[sizeof(uint32_t)] = {0};
+        in.read(header, sizeof(header));
+        if (in.gcount() < (std::streamsize)sizeof(header)) return false;
+
+        uint32_t magic;
+        memcpy(&magic, header, sizeof(magic));
+        return magic != MAGIC;
+    }
+
+    RecordId append(const ExecTrace::TraceEntry& entry) {
+        std::string record;
+        TraceRecord::encode(entry, record);
+
+        SlottedPage page(tail);
+        int slot = page.insert(record.data(), record.size());
+        if (slot < 0) {
+            tail_page_id = dm->allocate_page();
+            page.init();
+            slot = page.insert(record.data(), record.size());
+        }
+
+        dm->write_page(tail_page_id, tail);
+        max_id = std::max(max_id, entry.id);
+        return RecordId(tail_page_id, slot);
+    }
+
+    bool fetch(const RecordId& rid, ExecTrace::TraceEntry& out) {
+        if (!rid.is_valid() || rid.page_id >= dm->page_count()) return false;
+
+        // Index scans fetch runs of rows from the same page; keep the last one
+        const char* source = tail;
+        if (rid.page_id != tail_page_id) {
+            if (rid.page_id != cached_page_id) {
+                dm->read_page(rid.page_id, cached_page);
+                cached_page_id = rid.page_id;
+            }
+            source = cached_page;
+        }
+        SlottedPage page(const_cast<char*>(source));
+        int length;
+        const char* rec = page.record(rid.slot, length);
+        return rec && TraceRecord::decode(rec, length, out);
+    }
+
+    // Sets the deleted flag of the given records in place, reading and
+    // writing each page once. Returns how many records were marked.
+    size_t mark_deleted(std::vector<RecordId> rids) {
+        std::sort(rids.begin(), rids.end(), [](const RecordId& a, const RecordId& b) {
+            return a.page_id < b.page_id;
+        });
+
+        size_t marked = 0;
+        char buffer[PAGE_SIZE];
+        for (size_t i = 0; i < rids.size();) {
+            int page_id = rids[i].page_id;
+            if (!rids[i].is_valid() || page_id >= dm->page_count()) {
+                i++;
+                continue;
+            }
+            char* data = page_id == tail_page_id ? tail : buffer;
+            if (data == buffer) dm->read_page(page_id, buffer);
+            SlottedPage page(data);
+            for (; i < rids.size() && rids[i].page_id == page_id; i++) {
+                int length;
+                char* rec = page.mutable_record(rids[i].slot, length);
+                if (rec && length > 0) {
+                    rec[0] |= TraceRecord::FLAG_DELETED;
+                    marked++;
+                }
+            }
+            dm->write_page(page_id, data);
+            if (page_id == cached_page_id) cached_page_id = 0;
+        }
+        return marked;
+    }
+
+    // Copies one data page (including the unflushed tail) into `out`, so
+    // its records can be decoded without holding the caller's lock.
+    bool copy_page(int page_id, char* out) {
+        if (page_id <= 0 || page_id >= dm->page_count()) return false;
+        if (page_id == tail_page_id) {
+            memcpy(out, tail, PAGE_SIZE);
+        } else {
+            dm->read_page(page_id, out);
+        }
+        return true;
+    }
+
+    bool fetch(int id, ExecTrace::TraceEntry& out) {
+        if (id <= 0 || id > max_id) return false;
+
+        int target = page_of(id);
+        if (target == 0) return false;
+
+        char buffer[PAGE_SIZE];
+        dm->read_page(target, buffer);
+        SlottedPage page(buffer);
+        for (int slot = 0; slot < page.slot_count(); slot++) {
+            int length;
+            const char* rec = page.record(slot, length);
+            if (rec && TraceRecord::peek_id(rec, length) == id) {
+                return TraceRecord::decode(rec, length, out);
+            }
+        }
+        return false;
+    }
+
+    void scan(const std::function<void(const ExecTrace::TraceEntry&)>& visit) {
+        scan_records([&](const ExecTrace::TraceEntry& entry, const RecordId&) {
+            visit(entry);
+        });
+    }
+
+    void scan_records(const std::function<void(const ExecTrace::TraceEntry&, const RecordId&)>& visit) {
+        scan_records_after(0, visit);
+    }
+
+    // Visits the records with an id above `after_id`, starting from the
+    // page that holds the first of them, so replaying a short tail does not
+    // read the whole heap.
+    void scan_records_after(int after_id, const std::function<void(const ExecTrace::TraceEntry&, const RecordId&)>& visit) {
+        char buffer[PAGE_SIZE];
+        ExecTrace::TraceEntry entry;
+        int pages = dm->page_count();
+        int first_page = after_id > 0 ? std::max(1, page_of(after_id + 1)) : 1;
+
+        for (int page_id = first_page; page_id < pages; page_id++) {
+            dm->read_page(page_id, buffer);
+            SlottedPage page(buffer);
+            for (int slot = 0; slot < page.slot_count(); slot++) {
+                int length;
+                const char* rec = page.record(slot, length);
+                if (rec && TraceRecord::peek_id(rec, length) > after_id && TraceRecord::decode(rec, length, entry)) {
+                    visit(entry, RecordId(page_id, slot));
+                }
+            }
+        }
+    }
+
+    int get_max_id() const {
+        return max_id;
+    }
+
+    // Reads every node page of a legacy BTree<TraceEntry> file directly rather
+    // than walking from the root, so entries survive even if the old tree lost
+    // track of its root after a split.
+    static std::vector<LegacyTraceEntry> read_legacy_file(const std::string& filename) {
+        DiskManager legacy_dm(filename);
+        std::vector<LegacyTraceEntry> entries;
+        char buffer[PAGE_SIZE];
+
+        for (int page_id = 0; page_id < legacy_dm.page_count(); page_id++) {
+            legacy_dm.read_page(page_id, buffer);
+            Node<LegacyTraceEntry> node(page_id, true);
+            node.deserialize(buffer);
+            for (const auto& e : node.entries) {
+                if (e.id > 0) entries.push_back(e);
+            }
+        }
+
+        std::stable_sort(entries.begin(), entries.end());
+        auto last = std::unique(entries.begin(), entries.end());
+        entries.erase(last, entries.end());
+        return entries;
+    }
+
+    size_t import_legacy(const std::vector<LegacyTraceEntry>& entries,
+                         const std::function<void(ExecTrace::TraceEntry&)>& prepare) {
+        for (const auto& legacy : entries) {
+            ExecTrace::TraceEntry entry(legacy.id, legacy.project_id, legacy.func,
+                                        legacy.message, legacy.app_version,
+                                        legacy.duration, legacy.ram_usage);
+            entry.timestamp = legacy.timestamp;
+            entry.is_deleted = legacy.is_deleted;
+            if (prepare) prepare(entry);
+            append(entry);
+        }
+        return entries.size();
+    }
+
+    // Converts a pre-heap traces.db. The heap is built in <filename>.tmp and
+    // only renamed over the original once complete, so an interrupted
+    // conversion leaves the legacy file in place to be retried. A copy of the
+    // original is kept as <filename>.legacy (or .legacy.N if that exists).
+    // `prepare` runs on each entry before it is written, e.g. to assign
+    // dictionary ids.
+    static bool convert_legacy_file(const std::string& filename,
+                                    const std::function<void(ExecTrace::TraceEntry&)>& prepare = nullptr) {
+        std::string tmp = filename + ".tmp";
+        std::remove(tmp.c_str());
+
+        auto entries = read_legacy_file(filename);
+        size_t count;
+        {
+            TraceHeap heap(tmp);
+            count = heap.import_legacy(entries, prepare);
+        }
+
+        std::string backup = filename + ".legacy";
+        for (int n = 1; std::filesystem::exists(backup); n++) {
+            backup = filename + ".legacy." + std::to_string(n);
+        }
+        std::error_code ec;
+        std::filesystem::copy_file(filename, backup, ec);
+        if (ec) {
+            std::cerr << "[TraceHeap] Failed to back up legacy file " << filename << ": " << ec.message() << std::endl;
+            return false;
+        }
+        if (std::rename(tmp.c_str(), filename.c_str()) != 0) {
+            std::cerr << "[TraceHeap] Failed to replace legacy file: " << filename << std::endl;
+            return false;
+        }
+
+        std::cout << "[TraceHeap] Converted " << count << " legacy traces, original kept as "
+                  << backup << std::endl;
+        return true;
+    }
+};
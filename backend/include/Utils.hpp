@@ -40,6 +40,25 @@ inline std::string sanitize_string(const std::string& input, size_t max_length =
     return result;
 }
 
+// Decodes %XX escapes in a URL path segment.
+inline std::string url_decode(const std::string& input) {
+    std::string result;
+    result.reserve(input.length());
+
+    for (size_t i = 0; i < input.length(); i++) {
+        if (input[i] == '%' && i + 2 < input.length() &&
+            std::isxdigit(static_cast<unsigned char>(input[i + 1])) &&
+            std::isxdigit(static_cast<unsigned char>(input[i + 2]))) {
+            result += static_cast<char>(std::stoi(input.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            result += input[i];
+        }
+    }
+
+    return result;
+}
+
 inline bool validate_api_key(const std::string& api_key) {
     if (api_key.length() < 10 || api_key.length() > 128) {
         return false;
@@ -0,0 +1,251 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Delivers JSON notifications to plain-HTTP webhooks from a background
+// thread, so the caller never blocks on the network.
+//
+// Notifications queued within LINGER of each other for the same URL are
+// batched into one POST with the body {"alerts":[...]} (at most MAX_BATCH
+// per request). A failed batch (connection error, timeout or non-2xx
+// status) is retried with exponential backoff starting at 1s, up to
+// max_attempts, then dropped.
+//
+// Only hosts on the allowlist are ever contacted: entries are "host" (any
+// port) or "host:port", compared case-insensitively. With an empty list
+// every webhook is refused.
+class WebhookSender {
+private:
+    static const size_t MAX_BATCH = 100;
+    static constexpr std::chrono::milliseconds LINGER{200};
+
+    struct Batch {
+        std::string url;
+        std::vector<std::string> items;
+        int attempts;
+        std::chrono::steady_clock::time_point next_try;
+    };
+
+    std::vector<std::string> allowed_hosts;
+    int max_attempts;
+    std::chrono::milliseconds timeout;
+    std::map<std::string, std::vector<std::string>> pending;  // by URL
+    std::chrono::steady_clock::time_point pending_since;
+    std::deque<Batch> retries;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+    uint64_t delivered;
+    uint64_t dropped;
+    std::thread worker;
+
+    // "http://host[:port]/path"
+    static bool parse_url(const std::string& url, std::string& host, std::string& port, std::string& target) {
+        const std::string scheme = "http://";
+        if (url.compare(0, scheme.size(), scheme) != 0) return false;
+        size_t host_start = scheme.size();
+        size_t slash = url.find('/', host_start);
+        std::string authority = url.substr(host_start, slash == std::string::npos ? std::string::npos : slash - host_start);
+        target = slash == std::string::npos ? "/" : url.substr(slash);
+
+        if (authority.find('@') != std::string::npos) return false;
+
+        size_t colon = authority.rfind(':');
+        host = colon == std::string::npos ? authority : authority.substr(0, colon);
+        port = colon == std::string::npos ? "80" : authority.substr(colon + 1);
+        return !host.empty() && !port.empty();
+    }
+
+    static std::string lower(std::string s) {
+        for (auto& c : s) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        return s;
+    }
+
+    // One HTTP/1.1 POST; true on a 2xx response within the timeout.
+    bool post(const std::string& url, const std::string& body) {
+        namespace asio = boost::asio;
+        using tcp = asio::ip::tcp;
+
+        std::string host, port, target;
+        if (!parse_url(url, host, port, target)) return false;
+
+        std::string request = "POST " + target + " HTTP/1.1\r\n"
+                              "Host: " + host + "\r\n"
+                              "Content-Type: application/json\r\n"
+                              "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                              "Connection: close\r\n\r\n" + body;
+
+        asio::io_context io;
+        tcp::resolver resolver(io);
+        tcp::socket socket(io);
+        asio::streambuf response;
+        bool ok = false;
+
+        resolver.async_resolve(host, port, [&](const boost::system::error_code& ec, tcp::resolver::results_type endpoints) {
+            if (ec) return;
+            asio::async_connect(socket, endpoints, [&](const boost::system::error_code& ec, const tcp::endpoint&) {
+                if (ec) return;
+                asio::async_write(socket, asio::buffer(request), [&](const boost::system::error_code& ec, size_t) {
+                    if (ec) return;
+                    asio::async_read_until(socket, response, "\r\n", [&](const boost::system::error_code& ec, size_t) {
+                        if (ec) return;
+                        std::istream status_line(&response);
+                        std::string version;
+                        int status = 0;
+                        status_line >> version >> status;
+                        ok = status >= 200 && status < 300;
+                    });
+                });
+            });
+        });
+
+        io.run_for(timeout);
+        return ok;
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            auto now = std::chrono::steady_clock::now();
+            std::vector<Batch> due;
+
+            bool lingering = !pending.empty() && !stopping && now < pending_since + LINGER;
+            if (!lingering) {
+                for (auto& p : pending) {
+                    std::vector<std::string>& items = p.second;
+                    for (size_t i = 0; i < items.size(); i += MAX_BATCH) {
+                        size_t end = std::min(items.size(), i + MAX_BATCH);
+                        due.push_back(Batch{p.first, std::vector<std::string>(items.begin() + i, items.begin() + end),
+                                            0, now});
+                    }
+                }
+                pending.clear();
+            }
+            for (auto it = retries.begin(); it != retries.end();) {
+                if (stopping || it->next_try <= now) {
+                    due.push_back(std::move(*it));
+                    it = retries.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+
+            if (due.empty()) {
+                if (stopping && pending.empty()) break;
+                if (retries.empty() && !lingering) {
+                    wake.wait(lock);
+                } else {
+                    auto next = lingering ? pending_since + LINGER : retries.front().next_try;
+                    for (const auto& b : retries) next = std::min(next, b.next_try);
+                    wake.wait_until(lock, next);
+                }
+                continue;
+            }
+
+            lock.unlock();
+            for (auto& batch : due) {
+                std::string body = "{\"alerts\":[";
+                for (size_t i = 0; i < batch.items.size(); i++) {
+                    if (i > 0) body += ",";
+                    body += batch.items[i];
+                }
+                body += "]}";
+
+                bool sent = post(batch.url, body);
+                batch.attempts++;
+
+                std::lock_guard<std::mutex> relock(mutex);
+                if (sent) {
+                    delivered += batch.items.size();
+                    std::cout << "[Webhook] Delivered " << batch.items.size() << " alerts to " << batch.url << std::endl;
+                } else if (batch.attempts >= max_attempts || stopping) {
+                    dropped += batch.items.size();
+                    std::cerr << "[Webhook] Dropping " << batch.items.size() << " alerts for " << batch.url
+                              << " after " << batch.attempts << " attempts" << std::endl;
+                } else {
+                    batch.next_try = std::chrono::steady_clock::now() +
+                                     std::chrono::seconds(1LL << (batch.attempts - 1));
+                    std::cerr << "[Webhook] Delivery to " << batch.url << " failed, retry "
+                              << batch.attempts << "/" << max_attempts - 1 << std::endl;
+                    retries.push_back(std::move(batch));
+                }
+            }
+            lock.lock();
+        }
+    }
+
+public:
+    WebhookSender(const std::vector<std::string>& hosts, int attempts = 5,
+                  std::chrono::milliseconds request_timeout = std::chrono::milliseconds(5000))
+        : max_attempts(attempts), timeout(request_timeout), stopping(false), delivered(0), dropped(0) {
+        for (const auto& h : hosts) {
+            if (!h.empty()) allowed_hosts.push_back(lower(h));
+        }
+        std::cout << "[Webhook] " << allowed_hosts.size() << " allowed webhook hosts" << std::endl;
+        worker = std::thread(&WebhookSender::run, this);
+    }
+
+    // Gives everything still queued, including pending retries, one last
+    // attempt, then stops.
+    ~WebhookSender() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    static bool valid_url(const std::string& url) {
+        std::string host, port, target;
+        return parse_url(url, host, port, target);
+    }
+
+    // True if `url` is valid and its host is on the allowlist.
+    bool allows(const std::string& url) const {
+        std::string host, port, target;
+        if (!parse_url(url, host, port, target)) return false;
+        host = lower(host);
+        std::string host_port = host + ":" + port;
+        return std::find_if(allowed_hosts.begin(), allowed_hosts.end(), [&](const std::string& h) {
+            return h == host || h == host_port;
+        }) != allowed_hosts.end();
+    }
+
+    // `json` is one serialized notification object. URLs that are not
+    // allowed are dropped, e.g. rules saved before the allowlist changed.
+    void enqueue(const std::string& url, const std::string& json) {
+        if (!allows(url)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            dropped++;
+            std::cerr << "[Webhook] Refusing to deliver to " << url << ": host not allowed" << std::endl;
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (pending.empty()) pending_since = std::chrono::steady_clock::now();
+            pending[url].push_back(json);
+        }
+        wake.notify_one();
+    }
+
+    uint64_t delivered_count() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return delivered;
+    }
+
+    uint64_t dropped_count() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return dropped;
+    }
+};
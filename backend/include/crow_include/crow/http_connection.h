@@ -265,6 +265,10 @@ namespace crow
             {
                 do_write_static();
             }
+            else if (res.is_streamed())
+            {
+                do_write_streamed();
+            }
             else
             {
                 do_write_general();
@@ -363,6 +367,100 @@ namespace crow
             }
         }
 
+        void do_write_streamed()
+        {
+            // Reading is held back until the last chunk is out, so a pipelined
+            // request cannot replace `res` while its producer is still running.
+            is_streaming_ = true;
+            stream_done_ = false;
+            write_streamed(buffers_); // Write the response start / headers
+        }
+
+        // Every write runs under its own deadline: a client that stops reading
+        // gets its connection closed instead of pinning the worker thread.
+        void write_streamed(std::vector<asio::const_buffer>& buffers)
+        {
+            auto self = this->shared_from_this();
+            start_deadline();
+            asio::async_write(
+              adaptor_.socket(), buffers,
+              [self](const error_code& ec, std::size_t /*bytes_transferred*/) {
+                  self->cancel_deadline_timer();
+                  if (ec)
+                  {
+                      CROW_LOG_ERROR << ec << " - happened while streaming response";
+                      self->finish_streamed(ec);
+                  }
+                  else if (self->stream_done_)
+                  {
+                      self->finish_streamed(ec);
+                  }
+                  else
+                  {
+                      self->write_next_chunk();
+                  }
+              });
+        }
+
+        void write_next_chunk()
+        {
+            stream_chunk_.clear();
+            bool more = true;
+            try
+            {
+                while (more && stream_chunk_.empty())
+                    more = res.body_producer_(stream_chunk_);
+            }
+            catch (const std::exception& e)
+            {
+                // Drop the connection without the last chunk so the client sees a truncated body
+                CROW_LOG_ERROR << e.what() << " - happened while producing streamed response";
+                finish_streamed(asio::error::operation_aborted);
+                return;
+            }
+
+            stream_buffers_.clear();
+            if (!stream_chunk_.empty())
+            {
+                int n = snprintf(stream_size_line_, sizeof(stream_size_line_), "%zx\r\n", stream_chunk_.size());
+                stream_buffers_.emplace_back(asio::buffer(stream_size_line_, n));
+                stream_buffers_.emplace_back(asio::buffer(stream_chunk_));
+                stream_buffers_.emplace_back(asio::buffer(crlf));
+            }
+            if (!more)
+            {
+                static const std::string last_chunk = "0\r\n\r\n";
+                stream_buffers_.emplace_back(asio::buffer(last_chunk));
+                stream_done_ = true;
+            }
+            write_streamed(stream_buffers_);
+        }
+
+        void finish_streamed(const error_code& ec)
+        {
+            is_streaming_ = false;
+            if (close_connection_ || ec)
+            {
+                adaptor_.shutdown_readwrite();
+                adaptor_.close();
+                CROW_LOG_DEBUG << this << " from write (streamed)";
+            }
+
+            res.end();
+            res.clear();
+            buffers_.clear();
+            stream_buffers_.clear();
+            std::string().swap(stream_chunk_);
+            parser_.clear();
+
+            if (!close_connection_ && !ec && need_to_start_read_after_complete_)
+            {
+                need_to_start_read_after_complete_ = false;
+                start_deadline();
+                do_read();
+            }
+        }
+
         void do_read()
         {
             auto self = this->shared_from_this();
@@ -393,7 +491,7 @@ namespace crow
                       self->parser_.done();
                       // adaptor will close after write
                   }
-                  else if (!self->need_to_call_after_handlers_)
+                  else if (!self->need_to_call_after_handlers_ && !self->is_streaming_)
                   {
                       self->start_deadline();
                       self->do_read();
@@ -510,6 +608,12 @@ namespace crow
         bool need_to_call_after_handlers_{};
         bool need_to_start_read_after_complete_{};
         bool add_keep_alive_{};
+        bool is_streaming_{};
+        bool stream_done_{};
+
+        std::string stream_chunk_;
+        char stream_size_line_[20];
+        std::vector<asio::const_buffer> stream_buffers_;
 
         std::tuple<Middlewares...>* middlewares_;
         detail::context<Middlewares...> ctx_;
@@ -179,6 +179,7 @@ namespace crow
             headers = std::move(r.headers);
             completed_ = r.completed_;
             file_info = std::move(r.file_info);
+            body_producer_ = std::move(r.body_producer_);
             return *this;
         }
 
@@ -195,6 +196,7 @@ namespace crow
             headers.clear();
             completed_ = false;
             file_info = static_file_info{};
+            body_producer_ = nullptr;
         }
 
         /// Return a "Temporary Redirect" response.
@@ -276,6 +278,25 @@ namespace crow
             return is_alive_helper_ && is_alive_helper_();
         }
 
+        /// Stream the body with chunked transfer encoding instead of sending `body`.
+
+        ///
+        /// The producer is called repeatedly on the connection's thread after the
+        /// handler returns. Each call appends the next piece of the body to its
+        /// argument and returns false once nothing more will follow.
+        void set_body_producer(std::function<bool(std::string&)> producer)
+        {
+            body_producer_ = std::move(producer);
+            set_header("Transfer-Encoding", "chunked");
+            manual_length_header = true;
+        }
+
+        /// Check whether the response body is produced incrementally.
+        bool is_streamed() const
+        {
+            return static_cast<bool>(body_producer_);
+        }
+
         /// Check whether the response has a static file defined.
         bool is_static_type()
         {
@@ -413,7 +434,7 @@ namespace crow
                 buffers.emplace_back(crlf.data(), crlf.size());
             }
 
-            if (!manual_length_header && !headers.count("content-length"))
+            if (!manual_length_header && !body_producer_ && !headers.count("content-length"))
             {
                 content_length_buffer = std::to_string(body.size());
                 static std::string content_length_tag = "Content-Length: ";
@@ -449,6 +470,7 @@ namespace crow
         bool completed_{};
         std::function<void()> complete_request_handler_;
         std::function<bool()> is_alive_helper_;
+        std::function<bool(std::string&)> body_producer_;
         static_file_info file_info;
     };
 } // namespace crow
@@ -5,12 +5,16 @@
 #include "../include/AuthDB.hpp"
 #include "../include/Models.hpp"
 #include "../include/Utils.hpp"
+#include "../include/JsonWriter.hpp"
+#include "../include/WebhookSender.hpp"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <vector>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <chrono>
 
 #ifdef _WIN32
 #include <direct.h>   
@@ -22,6 +26,7 @@
 
 ExecTraceDB* trace_db = nullptr;
 AuthDB* auth_db = nullptr;
+WebhookSender* webhooks = nullptr;
 
 RateLimiter rate_limiter;
 
@@ -41,6 +46,58 @@ void ensure_directory_exists(const std::string& path) {
 #endif
 }
 
+// Once a second: evaluates alert rules, handing state changes to the
+// webhook sender, and builds the message index of one sealed segment.
+static void run_background_loop(std::atomic<bool>& running) {
+    while (running) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        trace_db->build_text_indexes(1);
+        for (const auto& event : trace_db->evaluate_alerts(time(nullptr))) {
+            JsonWriter json;
+            json.begin_object();
+            json.key("rule_id").value(event.rule_id);
+            json.key("project_id").value(event.project_id);
+            json.key("rule").value(event.expression);
+            json.key("state").value(event.firing ? "firing" : "resolved");
+            json.key("value").value(event.value);
+            json.key("threshold").value(event.threshold);
+            json.key("timestamp").value(event.timestamp);
+            json.end_object();
+            webhooks->enqueue(event.webhook, json.take());
+        }
+    }
+}
+
+// True if the request's X-API-Key belongs to `project_id`.
+static bool has_project_key(const crow::request& req, int project_id) {
+    std::string api_key = req.get_header_value("X-API-Key");
+    int key_project = 0;
+    return !api_key.empty() && auth_db && auth_db->get_project_id_from_api_key(api_key, key_project) &&
+           key_project == project_id;
+}
+
+// Comma-separated EXECTRACE_WEBHOOK_HOSTS, e.g. "hooks.example.com,10.0.0.5:9000".
+static std::vector<std::string> webhook_hosts_from_env() {
+    std::vector<std::string> hosts;
+    const char* env = getenv("EXECTRACE_WEBHOOK_HOSTS");
+    std::stringstream list(env ? env : "");
+    std::string host;
+    while (std::getline(list, host, ',')) {
+        host.erase(0, host.find_first_not_of(" \t"));
+        host.erase(host.find_last_not_of(" \t") + 1);
+        if (!host.empty()) hosts.push_back(host);
+    }
+    return hosts;
+}
+
+static void write_percentiles(JsonWriter& json, const LatencySketch& sketch) {
+    json.key("p50").value(sketch.quantile(0.50));
+    json.key("p90").value(sketch.quantile(0.90));
+    json.key("p95").value(sketch.quantile(0.95));
+    json.key("p99").value(sketch.quantile(0.99));
+    json.key("p99_9").value(sketch.quantile(0.999));
+}
+
 int main() {
     std::cout << "=== ExecTrace Server (Phase 3.1 - Routing Fixed) ===" << std::endl;
 
@@ -64,7 +121,11 @@ int main() {
 
     try {
         auth_db = new AuthDB("backend/data/users.db", "backend/data/projects.db");
-        trace_db = new ExecTraceDB("backend/data/traces.db");
+        std::vector<ProjectThresholds> thresholds;
+        for (const auto& project : auth_db->get_all_projects()) {
+            thresholds.push_back(ProjectThresholds{project.project_id, project.fast_threshold, project.normal_threshold});
+        }
+        trace_db = new ExecTraceDB("backend/data/traces.db", thresholds);
         std::cout << "[Server] Databases initialized" << std::endl;
     } catch (const std::exception& e) {
         std::cerr << "[Server ERROR] Failed to initialize databases: " << e.what() << std::endl;
@@ -455,20 +516,20 @@ int main() {
         try {
             auto projects = auth_db->get_projects_by_user(user_id);
 
-            std::string json = "{\"status\":\"ok\",\"projects\":[";
-            for (size_t i = 0; i < projects.size(); i++) {
-                if (i > 0) json += ",";
-                json += "{";
-                json += "\"id\":" + std::to_string(projects[i].project_id) + ",";
-                json += "\"name\":\"" + std::string(projects[i].name) + "\",";
-                json += "\"api_key\":\"" + std::string(projects[i].api_key) + "\",";
-                json += "\"fast_threshold\":" + std::to_string(projects[i].fast_threshold) + ",";
-                json += "\"normal_threshold\":" + std::to_string(projects[i].normal_threshold);
-                json += "}";
-            }
-            json += "]}";
+            JsonWriter json(64 + projects.size() * 160);
+            json.begin_object().key("status").value("ok").key("projects").begin_array();
+            for (const auto& project : projects) {
+                json.begin_object();
+                json.key("id").value(project.project_id);
+                json.key("name").value(project.name);
+                json.key("api_key").value(project.api_key);
+                json.key("fast_threshold").value(project.fast_threshold);
+                json.key("normal_threshold").value(project.normal_threshold);
+                json.end_object();
+            }
+            json.end_array().end_object();
             
-            crow::response resp(200, json);
+            crow::response resp(200, json.take());
             resp.add_header("Content-Type", "application/json");
             resp.add_header("Access-Control-Allow-Origin", "*");
             return resp;
@@ -498,6 +559,7 @@ int main() {
 
             if (auth_db->update_project_settings(project_id, fast_threshold, normal_threshold)) {
                 std::cout << "[Settings] Updated successfully" << std::endl;
+                trace_db->set_thresholds(project_id, fast_threshold, normal_threshold);
             }
             
             std::string json = "{\"status\":\"ok\",\"fast_threshold\":" + std::to_string(fast_threshold) +
@@ -522,6 +584,8 @@ int main() {
             bool result = auth_db->delete_project(project_id);
             if (result) {
                 std::cout << "[Server] Successfully deleted project " << project_id << std::endl;
+                size_t rules = trace_db->remove_project_alerts(project_id);
+                if (rules > 0) std::cout << "[Server] Removed " << rules << " alert rules of project " << project_id << std::endl;
                 std::string json = "{\"status\":\"ok\",\"message\":\"Project deleted\"}";
                 
                 crow::response resp(200, json);
@@ -566,21 +630,21 @@ int main() {
         try {
             auto users = auth_db->get_all_users();
 
-            std::string json = "{\"status\":\"ok\",\"users\":[";
-            for (size_t i = 0; i < users.size(); i++) {
-                if (i > 0) json += ",";
-                json += "{";
-                json += "\"user_id\":" + std::to_string(users[i].user_id) + ",";
-                json += "\"email\":\"" + std::string(users[i].email) + "\",";
-                json += "\"username\":\"" + std::string(users[i].username) + "\",";
-                json += "\"role\":" + std::to_string(users[i].role) + ",";
-                json += "\"is_active\":" + std::string(users[i].is_active ? "true" : "false") + ",";
-                json += "\"created_at\":" + std::to_string(users[i].created_at);
-                json += "}";
-            }
-            json += "]}";
+            JsonWriter json(64 + users.size() * 160);
+            json.begin_object().key("status").value("ok").key("users").begin_array();
+            for (const auto& user : users) {
+                json.begin_object();
+                json.key("user_id").value(user.user_id);
+                json.key("email").value(user.email);
+                json.key("username").value(user.username);
+                json.key("role").value(user.role);
+                json.key("is_active").value(user.is_active);
+                json.key("created_at").value(user.created_at);
+                json.end_object();
+            }
+            json.end_array().end_object();
             
-            crow::response resp(200, json);
+            crow::response resp(200, json.take());
             resp.add_header("Content-Type", "application/json");
             resp.add_header("Access-Control-Allow-Origin", "*");
             return resp;
@@ -703,56 +767,76 @@ int main() {
         std::cout << "\n[/query/advanced] Advanced query request" << std::endl;
         
         auto params = crow::query_string(req.url_params);
-        int limit = params.get("limit") ? std::stoi(params.get("limit")) : 50;
         std::string sort_by = params.get("sort_by") ? params.get("sort_by") : "duration";
         std::string sort_order = params.get("sort_order") ? params.get("sort_order") : "desc";
 
+        int limit;
+        int64_t from, to;
+        try {
+            limit = params.get("limit") ? std::stoi(params.get("limit")) : 50;
+            limit = std::max(1, std::min(limit, 10000));
+            from = params.get("from") ? std::stoll(params.get("from")) : INT64_MIN;
+            to = params.get("to") ? std::stoll(params.get("to")) : INT64_MAX;
+        } catch (const std::exception& e) {
+            crow::response resp(400, "{\"error\":\"Invalid limit, from or to\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        }
+
         std::string api_key = req.get_header_value("X-API-Key");
         int project_id = -1;
         
+        TraceSortKey sort_key = SORT_BY_DURATION;
+        if (sort_by == "ram") {
+            sort_key = SORT_BY_RAM;
+        } else if (sort_by == "func") {
+            sort_key = SORT_BY_FUNC;
+        }
+        bool descending = sort_order == "desc";
+
+        TraceFilter filter;
+        if (params.get("filter")) {
+            std::string error = filter.parse(params.get("filter"), static_cast<int64_t>(time(nullptr)));
+            if (!error.empty()) {
+                JsonWriter json;
+                json.begin_object().key("error").value("Invalid filter: " + error).end_object();
+                crow::response resp(400, json.take());
+                resp.add_header("Content-Type", "application/json");
+                return resp;
+            }
+        }
+
         std::vector<ExecTrace::TraceEntry> results;
         
         if (!api_key.empty() && auth_db && auth_db->get_project_id_from_api_key(api_key, project_id)) {
             std::cout << "[Query] Filtering for project " << project_id << std::endl;
-            results = trace_db->search_by_project(project_id);
+            if (sort_key == SORT_BY_DURATION && filter.empty()) {
+                results = trace_db->top_by_duration(project_id, (size_t)limit, descending, from, to);
+            } else {
+                results = trace_db->top_k(project_id, sort_key, descending, (size_t)limit, from, to, &filter);
+            }
         } else {
             std::cout << "[Query] No valid API key, returning all traces" << std::endl;
-            results = trace_db->get_all_traces();
+            results = trace_db->top_k(-1, sort_key, descending, (size_t)limit, from, to, &filter);
         }
         
         std::cout << "[Query] Limit: " << limit << ", Sort by: " << sort_by << " (" << sort_order << ")" << std::endl;
-        std::cout << "[Query] Found " << results.size() << " traces" << std::endl;
-
-        std::sort(results.begin(), results.end(), [&](const ExecTrace::TraceEntry& a, const ExecTrace::TraceEntry& b) {
-            bool result = false;
-            
-            if (sort_by == "duration") {
-                result = a.duration < b.duration;
-            } else if (sort_by == "ram") {
-                result = a.ram_usage < b.ram_usage;
-            } else if (sort_by == "func") {
-                result = std::string(a.func) < std::string(b.func);
-            } else {
-                result = a.duration < b.duration; 
-            }
+        std::cout << "[Query] Returning " << results.size() << " traces" << std::endl;
 
-            return sort_order == "desc" ? !result : result;
-        });
-
-        std::string json = "[";
+        JsonWriter json(16 + results.size() * 200);
+        json.begin_array();
         for (size_t i = 0; i < results.size() && i < (size_t)limit; i++) {
-            if (i > 0) json += ",";
-            json += "{";
-            json += "\"func\":\"" + std::string(results[i].func) + "\",";
-            json += "\"message\":\"" + std::string(results[i].message) + "\",";
-            json += "\"duration\":" + std::to_string(results[i].duration) + ",";
-            json += "\"ram\":" + std::to_string(results[i].ram_usage) + ",";
-            json += "\"app_version\":\"" + std::string(results[i].app_version) + "\"";
-            json += "}";
+            json.begin_object();
+            json.key("func").value(results[i].func);
+            json.key("message").value(results[i].message);
+            json.key("duration").value(results[i].duration);
+            json.key("ram").value(results[i].ram_usage);
+            json.key("app_version").value(results[i].app_version);
+            json.end_object();
         }
-        json += "]";
+        json.end_array();
         
-        crow::response resp(200, json);
+        crow::response resp(200, json.take());
         resp.add_header("Content-Type", "application/json");
         resp.add_header("Access-Control-Allow-Origin", "*");
         return resp;
@@ -763,11 +847,24 @@ int main() {
         std::cout << "\n[/api/project/info] Validating API key" << std::endl;
         
         std::string api_key = req.get_header_value("X-API-Key");
-        std::cout << "[Info] API Key: " << api_key << std::endl;
+        ExecTrace::ProjectEntry project;
+        if (api_key.empty() || !auth_db || !auth_db->get_project_by_api_key(api_key, project)) {
+            std::cout << "[Info] Invalid API key" << std::endl;
+            crow::response resp(401, "{\"error\":\"Invalid API key\"}");
+            resp.add_header("Content-Type", "application/json");
+            resp.add_header("Access-Control-Allow-Origin", "*");
+            return resp;
+        }
+        std::cout << "[Info] API key belongs to project " << project.project_id << std::endl;
 
-        std::string json = "{\"id\":1,\"name\":\"Demo Project\",\"api_key\":\"" + api_key + "\"}";
-        
-        crow::response resp(200, json);
+        JsonWriter json(256);
+        json.begin_object();
+        json.key("id").value(project.project_id);
+        json.key("name").value(project.name);
+        json.key("api_key").value(api_key);
+        json.end_object();
+
+        crow::response resp(200, json.take());
         resp.add_header("Content-Type", "application/json");
         resp.add_header("Access-Control-Allow-Origin", "*");
         return resp;
@@ -786,7 +883,7 @@ int main() {
     });
 
     CROW_ROUTE(app, "/logs/<int>")
-    ([](int project_id){
+    ([](const crow::request& req, int project_id){
         std::cout << "\n[/logs] ===== GET REQUEST FOR PROJECT " << project_id << " =====" << std::endl;
         std::cout.flush();
         
@@ -797,31 +894,54 @@ int main() {
                 return resp;
             }
             
-            auto results = trace_db->search_by_project(project_id);
+            auto params = crow::query_string(req.url_params);
+            int64_t from = params.get("from") ? std::stoll(params.get("from")) : INT64_MIN;
+            int64_t to = params.get("to") ? std::stoll(params.get("to")) : INT64_MAX;
+            int limit = params.get("limit") ? std::stoi(params.get("limit")) : 1000;
+            limit = std::max(1, std::min(limit, 10000));
+
+            ExecTrace::TraceCursor cursor;
+            bool has_cursor = params.get("cursor") != nullptr;
+            if (has_cursor && !ExecTrace::TraceCursor::decode(params.get("cursor"), cursor)) {
+                crow::response resp(400, "{\"error\":\"Invalid cursor\"}");
+                resp.add_header("Content-Type", "application/json");
+                return resp;
+            }
+
+            bool has_more = false;
+            auto results = trace_db->page_by_project(project_id, limit, has_cursor ? &cursor : nullptr,
+                                                     has_more, from, to);
             
             std::cout << "[/logs] Found " << results.size() << " entries" << std::endl;
 
-            std::string json = "{\"status\":\"ok\",\"count\":" + std::to_string(results.size()) + ",\"logs\":[";
+            JsonWriter json(128 + results.size() * 240);
+            json.begin_object();
+            json.key("status").value("ok");
+            json.key("count").value(results.size());
+            json.key("logs").begin_array();
             
-            for (size_t i = 0; i < results.size(); i++) {
-                const auto& entry = results[i];
-                if (i > 0) json += ",";
-                
-                json += "{";
-                json += "\"id\":" + std::to_string(entry.id) + ",";
-                json += "\"project_id\":" + std::to_string(entry.project_id) + ",";
-                json += "\"func\":\"" + std::string(entry.func) + "\",";
-                json += "\"message\":\"" + std::string(entry.message) + "\",";
-                json += "\"app_version\":\"" + std::string(entry.app_version) + "\",";
-                json += "\"duration\":" + std::to_string(entry.duration) + ",";
-                json += "\"ram_usage\":" + std::to_string(entry.ram_usage) + ",";
-                json += "\"timestamp\":" + std::to_string(entry.timestamp);
-                json += "}";
+            for (const auto& entry : results) {
+                json.begin_object();
+                json.key("id").value(entry.id);
+                json.key("project_id").value(entry.project_id);
+                json.key("func").value(entry.func);
+                json.key("message").value(entry.message);
+                json.key("app_version").value(entry.app_version);
+                json.key("duration").value(entry.duration);
+                json.key("ram_usage").value(entry.ram_usage);
+                json.key("timestamp").value(entry.timestamp);
+                json.end_object();
             }
             
-            json += "]}";
+            json.end_array().key("next_cursor");
+            if (has_more && !results.empty()) {
+                json.value(ExecTrace::TraceCursor(results.back().timestamp, results.back().id).encode());
+            } else {
+                json.null_value();
+            }
+            json.end_object();
             
-            crow::response resp(200, json);
+            crow::response resp(200, json.take());
             resp.add_header("Content-Type", "application/json");
             resp.add_header("Access-Control-Allow-Origin", "*");
             return resp;
@@ -854,37 +974,45 @@ int main() {
     CROW_ROUTE(app, "/api/stats/<int>")
     ([](const crow::request& req, int project_id){
         try {
-            auto all_traces = trace_db->search_by_project(project_id);
-            std::vector<ExecTrace::TraceEntry> active;
-            for (const auto& t : all_traces) {
-                if (!t.is_deleted) active.push_back(t);
+            auto params = crow::query_string(req.url_params);
+            int64_t from = params.get("from") ? std::stoll(params.get("from")) : INT64_MIN;
+            int64_t to = params.get("to") ? std::stoll(params.get("to")) : INT64_MAX;
+
+            ExecTrace::ProjectStats stats;
+            if (params.get("from") || params.get("to")) {
+                stats = trace_db->compute_stats(project_id, from, to);
+            } else {
+                stats = trace_db->project_stats(project_id);
             }
             
-            if (active.empty()) {
+            if (stats.count == 0) {
                 crow::response resp("{\"total\":0}");
                 resp.add_header("Content-Type", "application/json");
                 resp.add_header("Access-Control-Allow-Origin", "*");
                 return resp;
             }
             
-            uint64_t total_duration = 0, min_duration = UINT64_MAX, max_duration = 0;
-            uint64_t total_ram = 0;
-            for (const auto& t : active) {
-                total_duration += t.duration;
-                total_ram += t.ram_usage;
-                min_duration = std::min(min_duration, t.duration);
-                max_duration = std::max(max_duration, t.duration);
-            }
-            
-            uint64_t avg_duration = total_duration / active.size();
-            uint64_t avg_ram = total_ram / active.size();
+            uint64_t avg_duration = stats.total_duration / stats.count;
+            uint64_t avg_ram = stats.total_ram / stats.count;
             
-            std::stringstream json;
-            json << "{\"total\":" << active.size() << ","
-                 << "\"duration\":{\"avg\":" << avg_duration << ",\"min\":" << min_duration << ",\"max\":" << max_duration << "},"
-                 << "\"ram\":{\"avg\":" << avg_ram << "}}";
+            JsonWriter json;
+            json.begin_object();
+            json.key("total").value(stats.count);
+            json.key("duration").begin_object()
+                .key("avg").value(avg_duration)
+                .key("min").value(stats.min_duration)
+                .key("max").value(stats.max_duration);
+            write_percentiles(json, trace_db->latency_sketch(project_id, from, to));
+            json.end_object();
+            json.key("ram").begin_object().key("avg").value(avg_ram).end_object();
+            DistinctRow distinct = trace_db->distinct_counts(project_id, from, to);
+            json.key("distinct").begin_object()
+                .key("functions").value(distinct.funcs.estimate())
+                .key("versions").value(distinct.versions.estimate())
+                .end_object();
+            json.end_object();
             
-            crow::response resp(json.str());
+            crow::response resp(json.take());
             resp.add_header("Content-Type", "application/json");
             resp.add_header("Access-Control-Allow-Origin", "*");
             return resp;
@@ -892,11 +1020,902 @@ int main() {
             return crow::response(500, "{\"error\":\"Internal server error\"}");
         }
     });
+
+    CROW_ROUTE(app, "/api/project/<int>/percentiles")
+    ([](const crow::request& req, int project_id){
+        try {
+            auto params = crow::query_string(req.url_params);
+            int64_t from = params.get("from") ? std::stoll(params.get("from")) : INT64_MIN;
+            int64_t to = params.get("to") ? std::stoll(params.get("to")) : INT64_MAX;
+
+            LatencySketch sketch;
+            std::string func = params.get("func") ? ExecTrace::sanitize_string(params.get("func"), 128) : "";
+            if (func.empty()) {
+                sketch = trace_db->latency_sketch(project_id, from, to);
+            } else {
+                uint32_t func_id;
+                if (trace_db->lookup_func_id(project_id, func, func_id)) {
+                    sketch = trace_db->latency_sketch(project_id, from, to, &func_id);
+                }
+            }
+
+            JsonWriter json;
+            json.begin_object();
+            json.key("status").value("ok");
+            if (!func.empty()) json.key("func").value(func);
+            json.key("count").value(sketch.count());
+            json.key("min").value(sketch.min());
+            json.key("max").value(sketch.max());
+            write_percentiles(json, sketch);
+            json.end_object();
+
+            crow::response resp(200, json.take());
+            resp.add_header("Content-Type", "application/json");
+            resp.add_header("Access-Control-Allow-Origin", "*");
+            return resp;
+        } catch (const std::exception& e) {
+            crow::response resp(500, "{\"error\":\"Server error\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        }
+    });
+
+    CROW_ROUTE(app, "/api/project/<int>/aggregate")
+    ([](const crow::request& req, int project_id){
+        auto bad_request = [](const std::string& message) {
+            crow::response resp(400, "{\"error\":\"" + message + "\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        };
+
+        try {
+            auto params = crow::query_string(req.url_params);
+            int64_t from = params.get("from") ? std::stoll(params.get("from")) : INT64_MIN;
+            int64_t to = params.get("to") ? std::stoll(params.get("to")) : INT64_MAX;
+
+            std::string group_name = params.get("group_by") ? params.get("group_by") : "func";
+            AggregateGroup group_by;
+            if (group_name == "func") {
+                group_by = GROUP_BY_FUNC;
+            } else if (group_name == "version") {
+                group_by = GROUP_BY_VERSION;
+            } else if (group_name == "hour") {
+                group_by = GROUP_BY_HOUR;
+            } else {
+                return bad_request("group_by must be func, version or hour");
+            }
+
+            static const char* known_metrics[] = {
+                "count", "sum", "avg", "min", "max", "p50", "p90", "p95", "p99", "avg_ram", "max_ram",
+                "distinct_funcs", "distinct_versions"
+            };
+            std::vector<std::string> metrics;
+            std::stringstream metric_list(params.get("metrics") ? params.get("metrics") : "count,avg,p95,max_ram");
+            std::string metric;
+            AggregateOptions options;
+            while (std::getline(metric_list, metric, ',')) {
+                if (std::find(std::begin(known_metrics), std::end(known_metrics), metric) == std::end(known_metrics)) {
+                    return bad_request("Unknown metric");
+                }
+                if (metric[0] == 'p') options.percentiles = true;
+                if (metric.size() > 4 && metric.compare(metric.size() - 4, 4, "_ram") == 0) options.ram = true;
+                if (metric.compare(0, 9, "distinct_") == 0) {
+                    if (group_by != GROUP_BY_HOUR) return bad_request("Distinct counts need group_by=hour");
+                    options.distinct = true;
+                }
+                metrics.push_back(metric);
+            }
+
+            if (params.get("bands")) {
+                std::stringstream band_list(params.get("bands"));
+                std::string band;
+                while (std::getline(band_list, band, ',')) {
+                    uint64_t threshold = std::stoull(band);
+                    if (!options.bands.empty() && threshold <= options.bands.back()) {
+                        return bad_request("bands must be ascending");
+                    }
+                    options.bands.push_back(threshold);
+                }
+                if (options.bands.size() > 16) return bad_request("At most 16 bands");
+            }
+
+            std::vector<AggregateRow> groups = trace_db->aggregate(project_id, group_by, options, from, to);
+
+            JsonWriter json(128 + groups.size() * (64 + metrics.size() * 16));
+            json.begin_object();
+            json.key("status").value("ok");
+            json.key("group_by").value(group_name);
+            json.key("groups").begin_array();
+            for (const auto& g : groups) {
+                json.begin_object();
+                if (group_by == GROUP_BY_FUNC) {
+                    json.key("func").value(g.name);
+                } else if (group_by == GROUP_BY_VERSION) {
+                    json.key("version").value(g.name);
+                } else {
+                    json.key("hour").value(g.key);
+                }
+                for (const auto& m : metrics) {
+                    if (m == "count") json.key("count").value(g.count);
+                    else if (m == "sum") json.key("sum").value(g.sum);
+                    else if (m == "avg") json.key("avg").value(static_cast<double>(g.sum) / g.count);
+                    else if (m == "min") json.key("min").value(g.min);
+                    else if (m == "max") json.key("max").value(g.max);
+                    else if (m == "p50") json.key("p50").value(g.sketch.quantile(0.50));
+                    else if (m == "p90") json.key("p90").value(g.sketch.quantile(0.90));
+                    else if (m == "p95") json.key("p95").value(g.sketch.quantile(0.95));
+                    else if (m == "p99") json.key("p99").value(g.sketch.quantile(0.99));
+                    else if (m == "avg_ram") json.key("avg_ram").value(static_cast<double>(g.sum_ram) / g.count);
+                    else if (m == "max_ram") json.key("max_ram").value(g.max_ram);
+                    else if (m == "distinct_funcs") json.key("distinct_funcs").value(g.distinct.funcs.estimate());
+                    else if (m == "distinct_versions") json.key("distinct_versions").value(g.distinct.versions.estimate());
+                }
+                if (!g.bands.empty()) {
+                    json.key("bands").begin_array();
+                    for (uint64_t c : g.bands) json.value(c);
+                    json.end_array();
+                }
+                json.end_object();
+            }
+            json.end_array().end_object();
+
+            crow::response resp(200, json.take());
+            resp.add_header("Content-Type", "application/json");
+            resp.add_header("Access-Control-Allow-Origin", "*");
+            return resp;
+        } catch (const std::invalid_argument& e) {
+            return bad_request("Invalid parameters");
+        } catch (const std::out_of_range& e) {
+            return bad_request("Invalid parameters");
+        } catch (const std::exception& e) {
+            crow::response resp(500, "{\"error\":\"Server error\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        }
+    });
+
+    CROW_ROUTE(app, "/api/project/<int>/compare")
+    ([](const crow::request& req, int project_id){
+        try {
+            auto params = crow::query_string(req.url_params);
+            if (!params.get("base") || !params.get("head")) {
+                crow::response resp(400, "{\"error\":\"base and head versions are required\"}");
+                resp.add_header("Content-Type", "application/json");
+                return resp;
+            }
+            std::string base = ExecTrace::sanitize_string(params.get("base"), 32);
+            std::string head = ExecTrace::sanitize_string(params.get("head"), 32);
+            int64_t from = params.get("from") ? std::stoll(params.get("from")) : INT64_MIN;
+            int64_t to = params.get("to") ? std::stoll(params.get("to")) : INT64_MAX;
+            int limit = params.get("limit") ? std::stoi(params.get("limit")) : 50;
+            limit = std::max(1, std::min(limit, 1000));
+
+            uint32_t base_id, head_id;
+            if (!trace_db->lookup_version_id(project_id, base, base_id) ||
+                !trace_db->lookup_version_id(project_id, head, head_id)) {
+                crow::response resp(404, "{\"error\":\"Unknown version\"}");
+                resp.add_header("Content-Type", "application/json");
+                return resp;
+            }
+
+            std::vector<VersionComparison> functions = trace_db->compare_versions(project_id, base_id, head_id, from, to);
+            std::sort(functions.begin(), functions.end(), [](const VersionComparison& a, const VersionComparison& b) {
+                return a.p95_change() > b.p95_change();
+            });
+            if (functions.size() > static_cast<size_t>(limit)) functions.resize(limit);
+
+            auto write_version = [](JsonWriter& json, const LatencySketch& sketch) {
+                json.begin_object();
+                json.key("count").value(sketch.count());
+                json.key("p50").value(sketch.quantile(0.50));
+                json.key("p95").value(sketch.quantile(0.95));
+                json.key("p99").value(sketch.quantile(0.99));
+                json.end_object();
+            };
+
+            JsonWriter json(128 + functions.size() * 256);
+            json.begin_object();
+            json.key("status").value("ok");
+            json.key("base").value(base);
+            json.key("head").value(head);
+            json.key("functions").begin_array();
+            for (const auto& f : functions) {
+                double z = f.z_score();
+                json.begin_object();
+                json.key("func").value(f.func);
+                json.key("base");
+                write_version(json, f.base);
+                json.key("head");
+                write_version(json, f.head);
+                json.key("p95_change").value(f.p95_change());
+                json.key("z").value(z);
+                json.key("significant").value(z >= 1.96 && f.base.count() >= 20 && f.head.count() >= 20);
+                json.end_object();
+            }
+            json.end_array().end_object();
+
+            crow::response resp(200, json.take());
+            resp.add_header("Content-Type", "application/json");
+            resp.add_header("Access-Control-Allow-Origin", "*");
+            return resp;
+        } catch (const std::exception& e) {
+            crow::response resp(500, "{\"error\":\"Server error\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        }
+    });
+
+    CROW_ROUTE(app, "/api/project/<int>/anomalies")
+    ([](const crow::request& req, int project_id){
+        try {
+            auto params = crow::query_string(req.url_params);
+            int64_t from = params.get("from") ? std::stoll(params.get("from")) : INT64_MIN;
+            int64_t to = params.get("to") ? std::stoll(params.get("to")) : INT64_MAX;
+            int limit = params.get("limit") ? std::stoi(params.get("limit")) : 100;
+            limit = std::max(1, std::min(limit, 1000));
+
+            std::vector<FlaggedTrace> flagged = trace_db->flagged_events(project_id, (size_t)limit, from, to);
+
+            JsonWriter json(128 + flagged.size() * 256);
+            json.begin_object();
+            json.key("status").value("ok");
+            json.key("count").value(flagged.size());
+            json.key("anomalies").begin_array();
+            for (const auto& f : flagged) {
+                json.begin_object();
+                json.key("id").value(f.entry.id);
+                json.key("func").value(f.entry.func);
+                json.key("message").value(f.entry.message);
+                json.key("app_version").value(f.entry.app_version);
+                json.key("duration").value(f.entry.duration);
+                json.key("ram_usage").value(f.entry.ram_usage);
+                json.key("timestamp").value(static_cast<int64_t>(f.entry.timestamp));
+                json.key("reasons").begin_array();
+                if (f.reasons & ANOMALY_SLOW) json.value("slow");
+                if (f.reasons & ANOMALY_ZSCORE) json.value("zscore");
+                json.end_array();
+                json.key("z").value(static_cast<double>(f.z_score));
+                json.end_object();
+            }
+            json.end_array().end_object();
+
+            crow::response resp(200, json.take());
+            resp.add_header("Content-Type", "application/json");
+            resp.add_header("Access-Control-Allow-Origin", "*");
+            return resp;
+        } catch (const std::exception& e) {
+            crow::response resp(500, "{\"error\":\"Server error\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        }
+    });
+
+    CROW_ROUTE(app, "/api/project/<int>/anomalies/functions")
+    ([](int project_id){
+        std::vector<FunctionHealth> functions = trace_db->function_health(project_id);
+
+        JsonWriter json(128 + functions.size() * 160);
+        json.begin_object();
+        json.key("status").value("ok");
+        json.key("functions").begin_array();
+        for (const auto& f : functions) {
+            json.begin_object();
+            json.key("func").value(f.func);
+            json.key("calls").value(f.baseline.calls);
+            json.key("slow_calls").value(f.baseline.slow_calls);
+            json.key("flagged").value(f.baseline.flagged);
+            json.key("ewma_mean").value(f.baseline.mean);
+            json.key("ewma_stddev").value(f.baseline.stddev());
+            json.end_object();
+        }
+        json.end_array().end_object();
+
+        crow::response resp(200, json.take());
+        resp.add_header("Content-Type", "application/json");
+        resp.add_header("Access-Control-Allow-Origin", "*");
+        return resp;
+    });
+
+    CROW_ROUTE(app, "/api/project/<int>/top")
+    ([](const crow::request& req, int project_id){
+        try {
+            auto params = crow::query_string(req.url_params);
+            std::string by = params.get("by") ? params.get("by") : "calls";
+            HitterMetric metric;
+            if (by == "calls") {
+                metric = HITTERS_CALLS;
+            } else if (by == "time") {
+                metric = HITTERS_TIME;
+            } else {
+                crow::response resp(400, "{\"error\":\"by must be calls or time\"}");
+                resp.add_header("Content-Type", "application/json");
+                return resp;
+            }
+            int k = params.get("k") ? std::stoi(params.get("k")) : 20;
+            k = std::max(1, std::min(k, 1000));
+
+            std::vector<TopFunction> top = trace_db->top_functions(project_id, metric, (size_t)k);
+
+            JsonWriter json(128 + top.size() * 128);
+            json.begin_object();
+            json.key("status").value("ok");
+            json.key("by").value(by);
+            json.key("functions").begin_array();
+            for (const auto& t : top) {
+                json.begin_object();
+                json.key("func").value(t.func);
+                json.key("value").value(t.hitter.count);
+                json.key("error").value(t.hitter.error);
+                json.key("guaranteed").value(t.hitter.guaranteed);
+                json.end_object();
+            }
+            json.end_array().end_object();
+
+            crow::response resp(200, json.take());
+            resp.add_header("Content-Type", "application/json");
+            resp.add_header("Access-Control-Allow-Origin", "*");
+            return resp;
+        } catch (const std::exception& e) {
+            crow::response resp(500, "{\"error\":\"Server error\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        }
+    });
+
+    CROW_ROUTE(app, "/api/project/<int>/functions")
+    ([](const crow::request& req, int project_id){
+        try {
+            auto params = crow::query_string(req.url_params);
+            std::string prefix = params.get("prefix") ? ExecTrace::sanitize_string(params.get("prefix"), 128) : "";
+            int limit = params.get("limit") ? std::stoi(params.get("limit")) : 10;
+            limit = std::max(1, std::min(limit, 100));
+
+            std::vector<FunctionSuggestion> matches = trace_db->complete_functions(project_id, prefix, (size_t)limit);
+
+            JsonWriter json(128 + matches.size() * 96);
+            json.begin_object();
+            json.key("status").value("ok");
+            json.key("prefix").value(prefix);
+            json.key("functions").begin_array();
+            for (const auto& m : matches) {
+                json.begin_object();
+                json.key("func").value(m.func);
+                json.key("calls").value(m.calls);
+                json.end_object();
+            }
+            json.end_array().end_object();
+
+            crow::response resp(200, json.take());
+            resp.add_header("Content-Type", "application/json");
+            resp.add_header("Access-Control-Allow-Origin", "*");
+            return resp;
+        } catch (const std::exception& e) {
+            crow::response resp(500, "{\"error\":\"Server error\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        }
+    });
+
+    CROW_ROUTE(app, "/api/project/<int>/alerts").methods(crow::HTTPMethod::Get, crow::HTTPMethod::Post)
+    ([](const crow::request& req, int project_id){
+        if (!has_project_key(req, project_id)) {
+            crow::response resp(401, "{\"error\":\"Invalid API key for this project\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        }
+
+        if (req.method == crow::HTTPMethod::Post) {
+            auto params = crow::query_string(req.body, false);
+            std::string rule = params.get("rule") ? params.get("rule") : "";
+            std::string webhook = params.get("webhook") ? params.get("webhook") : "";
+
+            std::string error;
+            if (rule.empty() || rule.size() > 256 || rule.find_first_of("\t\r\n") != std::string::npos) {
+                error = "rule must be a single line of at most 256 characters";
+            } else if (webhook.size() > 512 || webhook.find_first_of(" \t\r\n") != std::string::npos ||
+                       !WebhookSender::valid_url(webhook)) {
+                error = "webhook must be an http:// URL";
+            } else if (!webhooks->allows(webhook)) {
+                error = "webhook host is not in EXECTRACE_WEBHOOK_HOSTS";
+            }
+
+            int rule_id = 0;
+            if (error.empty()) rule_id = trace_db->add_alert_rule(project_id, rule, webhook, error);
+
+            JsonWriter json;
+            json.begin_object();
+            if (rule_id == 0) {
+                json.key("error").value(error);
+            } else {
+                json.key("status").value("ok");
+                json.key("id").value(rule_id);
+            }
+            json.end_object();
+
+            crow::response resp(rule_id == 0 ? 400 : 200, json.take());
+            resp.add_header("Content-Type", "application/json");
+            resp.add_header("Access-Control-Allow-Origin", "*");
+            return resp;
+        }
+
+        auto rules = trace_db->alert_rules(project_id);
+        JsonWriter json(128 + rules.size() * 160);
+        json.begin_object();
+        json.key("status").value("ok");
+        json.key("rules").begin_array();
+        for (const auto& r : rules) {
+            json.begin_object();
+            json.key("id").value(r.first.id);
+            json.key("rule").value(r.first.expression);
+            json.key("webhook").value(r.first.webhook);
+            json.key("firing").value(r.second);
+            json.end_object();
+        }
+        json.end_array().end_object();
+
+        crow::response resp(200, json.take());
+        resp.add_header("Content-Type", "application/json");
+        resp.add_header("Access-Control-Allow-Origin", "*");
+        return resp;
+    });
+
+    CROW_ROUTE(app, "/api/project/<int>/alerts/<int>").methods(crow::HTTPMethod::Delete)
+    ([](const crow::request& req, int project_id, int rule_id){
+        if (!has_project_key(req, project_id)) {
+            crow::response resp(401, "{\"error\":\"Invalid API key for this project\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        }
+
+        bool removed = trace_db->remove_alert_rule(project_id, rule_id);
+        crow::response resp(removed ? 200 : 404,
+                            removed ? "{\"status\":\"ok\"}" : "{\"error\":\"Rule not found\"}");
+        resp.add_header("Content-Type", "application/json");
+        resp.add_header("Access-Control-Allow-Origin", "*");
+        return resp;
+    });
+
+    CROW_ROUTE(app, "/api/project/<int>/rollup")
+    ([](const crow::request& req, int project_id){
+        try {
+            auto params = crow::query_string(req.url_params);
+            int64_t from = params.get("from") ? std::stoll(params.get("from")) : INT64_MIN;
+            int64_t to = params.get("to") ? std::stoll(params.get("to")) : INT64_MAX;
+
+            // Without an explicit resolution pick the finest one that keeps
+            // the series under ~500 points
+            RollupLevel level = ROLLUP_HOUR;
+            if (params.get("resolution")) {
+                if (!RollupStore::parse_level(params.get("resolution"), level)) {
+                    crow::response resp(400, "{\"error\":\"resolution must be 1m, 1h or 1d\"}");
+                    resp.add_header("Content-Type", "application/json");
+                    return resp;
+                }
+            } else if (from != INT64_MIN && to != INT64_MAX && to >= from) {
+                level = ROLLUP_MINUTE;
+                while (level < ROLLUP_DAY && (to - from) / RollupStore::bucket_seconds(level) > 500) {
+                    level = (RollupLevel)(level + 1);
+                }
+            }
+
+            std::vector<std::pair<int64_t, RollupRow>> series;
+            std::string func = params.get("func") ? ExecTrace::sanitize_string(params.get("func"), 128) : "";
+            if (func.empty()) {
+                series = trace_db->rollup_series(project_id, level, from, to);
+            } else {
+                uint32_t func_id;
+                if (trace_db->lookup_func_id(project_id, func, func_id)) {
+                    series = trace_db->rollup_series(project_id, level, from, to, &func_id);
+                }
+            }
+
+            JsonWriter json(128 + series.size() * 128);
+            json.begin_object();
+            json.key("status").value("ok");
+            json.key("resolution").value(RollupStore::level_name(level));
+            json.key("series").begin_array();
+            for (const auto& point : series) {
+                const RollupRow& row = point.second;
+                json.begin_object();
+                json.key("t").value(point.first);
+                json.key("count").value(row.count);
+                json.key("avg").value(row.avg());
+                json.key("min").value(row.min);
+                json.key("max").value(row.max);
+                json.key("p50").value(row.sketch.quantile(0.50));
+                json.key("p95").value(row.sketch.quantile(0.95));
+                json.key("p99").value(row.sketch.quantile(0.99));
+                json.end_object();
+            }
+            json.end_array().end_object();
+
+            crow::response resp(200, json.take());
+            resp.add_header("Content-Type", "application/json");
+            resp.add_header("Access-Control-Allow-Origin", "*");
+            return resp;
+        } catch (const std::exception& e) {
+            crow::response resp(500, "{\"error\":\"Server error\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        }
+    });
+
+    CROW_ROUTE(app, "/api/project/<int>/search")
+    ([](const crow::request& req, int project_id){
+        try {
+            auto params = crow::query_string(req.url_params);
+            int64_t from = params.get("from") ? std::stoll(params.get("from")) : INT64_MIN;
+            int64_t to = params.get("to") ? std::stoll(params.get("to")) : INT64_MAX;
+            int limit = params.get("limit") ? std::stoi(params.get("limit")) : 50;
+            limit = std::max(1, std::min(limit, 1000));
+            std::string query = params.get("q") ? params.get("q") : "";
+            if (query.size() < 3 || query.size() > 256) {
+                crow::response resp(400, "{\"error\":\"q must be 3 to 256 characters\"}");
+                resp.add_header("Content-Type", "application/json");
+                return resp;
+            }
+
+            size_t indexed = 0;
+            std::vector<ExecTrace::TraceEntry> traces =
+                trace_db->search_messages(project_id, query, (size_t)limit, indexed, from, to);
+
+            JsonWriter json(128 + traces.size() * 256);
+            json.begin_object();
+            json.key("status").value("ok");
+            json.key("count").value(traces.size());
+            json.key("indexed_segments").value(indexed);
+            json.key("traces").begin_array();
+            for (const auto& t : traces) {
+                json.begin_object();
+                json.key("id").value(t.id);
+                json.key("func").value(t.func);
+                json.key("message").value(t.message);
+                json.key("app_version").value(t.app_version);
+                json.key("duration").value(t.duration);
+                json.key("ram_usage").value(t.ram_usage);
+                json.key("timestamp").value(static_cast<int64_t>(t.timestamp));
+                json.end_object();
+            }
+            json.end_array().end_object();
+
+            crow::response resp(200, json.take());
+            resp.add_header("Content-Type", "application/json");
+            resp.add_header("Access-Control-Allow-Origin", "*");
+            return resp;
+        } catch (const std::exception& e) {
+            crow::response resp(500, "{\"error\":\"Server error\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        }
+    });
+
+    CROW_ROUTE(app, "/api/project/<int>/search/index").methods(crow::HTTPMethod::Get, crow::HTTPMethod::Put, crow::HTTPMethod::Delete)
+    ([](const crow::request& req, int project_id){
+        if (req.method != crow::HTTPMethod::Get && !has_project_key(req, project_id)) {
+            crow::response resp(401, "{\"error\":\"Invalid API key for this project\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        }
+
+        bool ok = true;
+        if (req.method == crow::HTTPMethod::Put) {
+            ok = trace_db->set_text_search(project_id, true);
+        } else if (req.method == crow::HTTPMethod::Delete) {
+            ok = trace_db->set_text_search(project_id, false);
+        }
+        if (!ok) {
+            crow::response resp(500, "{\"error\":\"Failed to save search settings\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        }
+
+        JsonWriter json;
+        json.begin_object();
+        json.key("status").value("ok");
+        json.key("enabled").value(trace_db->text_search_enabled(project_id));
+        json.end_object();
+
+        crow::response resp(200, json.take());
+        resp.add_header("Content-Type", "application/json");
+        resp.add_header("Access-Control-Allow-Origin", "*");
+        return resp;
+    });
+
+    CROW_ROUTE(app, "/api/project/<int>/series")
+    ([](const crow::request& req, int project_id){
+        try {
+            auto params = crow::query_string(req.url_params);
+            int64_t from = params.get("from") ? std::stoll(params.get("from")) : INT64_MIN;
+            int64_t to = params.get("to") ? std::stoll(params.get("to")) : INT64_MAX;
+            std::string metric = params.get("metric") ? params.get("metric") : "duration";
+            if (metric != "duration" && metric != "ram") {
+                crow::response resp(400, "{\"error\":\"metric must be duration or ram\"}");
+                resp.add_header("Content-Type", "application/json");
+                return resp;
+            }
+            int points = params.get("points") ? std::stoi(params.get("points")) : 500;
+            points = std::max(3, std::min(points, 5000));
+
+            std::vector<SeriesPoint> series;
+            size_t total = 0;
+            std::string func = params.get("func") ? ExecTrace::sanitize_string(params.get("func"), 128) : "";
+            if (func.empty()) {
+                series = trace_db->downsample(project_id, metric == "ram", (size_t)points, total, from, to);
+            } else {
+                uint32_t func_id;
+                if (trace_db->lookup_func_id(project_id, func, func_id)) {
+                    series = trace_db->downsample(project_id, metric == "ram", (size_t)points, total, from, to, &func_id);
+                }
+            }
+
+            JsonWriter json(128 + series.size() * 40);
+            json.begin_object();
+            json.key("status").value("ok");
+            json.key("metric").value(metric);
+            json.key("total").value(total);
+            json.key("points").begin_array();
+            for (const auto& p : series) {
+                json.begin_array().value(p.timestamp).value(p.value).end_array();
+            }
+            json.end_array().end_object();
+
+            crow::response resp(200, json.take());
+            resp.add_header("Content-Type", "application/json");
+            resp.add_header("Access-Control-Allow-Origin", "*");
+            return resp;
+        } catch (const std::exception& e) {
+            crow::response resp(500, "{\"error\":\"Server error\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        }
+    });
+
+    CROW_ROUTE(app, "/api/project/<int>/heatmap")
+    ([](const crow::request& req, int project_id){
+        try {
+            auto params = crow::query_string(req.url_params);
+            int64_t to = params.get("to") ? std::stoll(params.get("to")) : static_cast<int64_t>(time(nullptr));
+            int64_t from = params.get("from") ? std::stoll(params.get("from")) : to - 7 * 86400;
+            if (to < from) {
+                crow::response resp(400, "{\"error\":\"from must not be after to\"}");
+                resp.add_header("Content-Type", "application/json");
+                return resp;
+            }
+
+            // Steps are whole minutes so every column is made of rollup
+            // buckets; by default aim for ~200 columns
+            int64_t step = 0;
+            if (params.get("step")) {
+                step = std::stoll(params.get("step"));
+            } else {
+                for (int64_t s : {60, 300, 900, 3600, 4 * 3600, 86400}) {
+                    step = s;
+                    if ((to - from) / s <= 200) break;
+                }
+                while ((to - from) / step > 200) step += 86400;
+            }
+            if (step < 60 || step % 60 != 0) {
+                crow::response resp(400, "{\"error\":\"step must be a positive multiple of 60 seconds\"}");
+                resp.add_header("Content-Type", "application/json");
+                return resp;
+            }
+            if ((to - from) / step > 2000) {
+                crow::response resp(400, "{\"error\":\"Too many columns, use a larger step\"}");
+                resp.add_header("Content-Type", "application/json");
+                return resp;
+            }
+
+            Heatmap map;
+            std::string func = params.get("func") ? ExecTrace::sanitize_string(params.get("func"), 128) : "";
+            if (func.empty()) {
+                map = trace_db->heatmap(project_id, from, to, step);
+            } else {
+                uint32_t func_id;
+                if (trace_db->lookup_func_id(project_id, func, func_id)) {
+                    map = trace_db->heatmap(project_id, from, to, step, &func_id);
+                } else {
+                    map.step = step;
+                }
+            }
+
+            JsonWriter json(256 + map.times.size() * (16 + (map.max_bin - map.min_bin + 1) * 4));
+            json.begin_object();
+            json.key("status").value("ok");
+            json.key("step").value(map.step);
+            json.key("resolution").value(RollupStore::level_name(map.level));
+            json.key("times").begin_array();
+            for (int64_t t : map.times) json.value(t);
+            json.end_array();
+            json.key("buckets").begin_array();
+            for (int bin = map.min_bin; bin <= map.max_bin; bin++) {
+                json.begin_object();
+                json.key("low").value(Heatmap::bin_low(bin));
+                json.key("high").value(Heatmap::bin_high(bin));
+                json.end_object();
+            }
+            json.end_array();
+            json.key("counts").begin_array();
+            for (const auto& column : map.counts) {
+                json.begin_array();
+                for (uint64_t c : column) json.value(c);
+                json.end_array();
+            }
+            json.end_array().end_object();
+
+            crow::response resp(200, json.take());
+            resp.add_header("Content-Type", "application/json");
+            resp.add_header("Access-Control-Allow-Origin", "*");
+            return resp;
+        } catch (const std::exception& e) {
+            crow::response resp(500, "{\"error\":\"Server error\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        }
+    });
+
+    CROW_ROUTE(app, "/api/project/<int>/func/<string>/traces")
+    ([](const crow::request& req, int project_id, const std::string& raw_func){
+        // Names are sanitized at ingest, so sanitize the lookup the same way
+        std::string func = ExecTrace::sanitize_string(ExecTrace::url_decode(raw_func), 128);
+        std::cout << "\n[/api/project/func/traces] " << func << " in project " << project_id << std::endl;
+
+        try {
+            auto params = crow::query_string(req.url_params);
+            int64_t from = params.get("from") ? std::stoll(params.get("from")) : INT64_MIN;
+            int64_t to = params.get("to") ? std::stoll(params.get("to")) : INT64_MAX;
+
+            auto results = trace_db->search_by_function(project_id, func, from, to);
+
+            JsonWriter json(128 + results.size() * 200);
+            json.begin_object();
+            json.key("status").value("ok");
+            json.key("func").value(func);
+            json.key("count").value(results.size());
+            json.key("traces").begin_array();
+            for (const auto& entry : results) {
+                json.begin_object();
+                json.key("id").value(entry.id);
+                json.key("message").value(entry.message);
+                json.key("app_version").value(entry.app_version);
+                json.key("duration").value(entry.duration);
+                json.key("ram_usage").value(entry.ram_usage);
+                json.key("timestamp").value(entry.timestamp);
+                json.end_object();
+            }
+            json.end_array().end_object();
+
+            crow::response resp(200, json.take());
+            resp.add_header("Content-Type", "application/json");
+            resp.add_header("Access-Control-Allow-Origin", "*");
+            return resp;
+        } catch (const std::exception& e) {
+            std::cerr << "[/api/project/func/traces ERROR] " << e.what() << std::endl;
+
+            crow::response resp(500, "{\"error\":\"Server error\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        }
+    });
+
+    // Streams every trace in the window as a chunked JSON array. Rows are
+    // pulled from the timestamp index a page at a time, so the response never
+    // holds more than one page in memory.
+    CROW_ROUTE(app, "/api/project/<int>/export")
+    ([](const crow::request& req, int project_id){
+        std::cout << "\n[/api/project/export] Streaming traces for project " << project_id << std::endl;
+
+        struct ExportState {
+            ExecTrace::TraceCursor cursor;
+            bool started = false;
+            bool more = true;
+            size_t rows = 0;
+        };
+
+        try {
+            auto params = crow::query_string(req.url_params);
+            int64_t from = params.get("from") ? std::stoll(params.get("from")) : INT64_MIN;
+            int64_t to = params.get("to") ? std::stoll(params.get("to")) : INT64_MAX;
+
+            auto state = std::make_shared<ExportState>();
+            crow::response resp(200);
+            resp.add_header("Content-Type", "application/json");
+            resp.add_header("Access-Control-Allow-Origin", "*");
+            resp.set_body_producer([state, project_id, from, to](std::string& chunk) {
+                const size_t page_rows = 500;
+
+                size_t start = chunk.size();
+                try {
+                    if (!state->started) chunk += "[";
+                    auto page = trace_db->page_by_project(project_id, page_rows,
+                                                          state->started ? &state->cursor : nullptr,
+                                                          state->more, from, to);
+                    state->started = true;
+
+                    JsonWriter json(chunk);
+                    json.reserve(page.size() * 200);
+                    for (const auto& entry : page) {
+                        if (state->rows++ > 0) chunk += ",";
+
+                        json.begin_object();
+                        json.key("id").value(entry.id);
+                        json.key("func").value(entry.func);
+                        json.key("message").value(entry.message);
+                        json.key("app_version").value(entry.app_version);
+                        json.key("duration").value(entry.duration);
+                        json.key("ram_usage").value(entry.ram_usage);
+                        json.key("timestamp").value(entry.timestamp);
+                        json.end_object();
+                    }
+                    if (!page.empty()) {
+                        state->cursor = ExecTrace::TraceCursor(page.back().timestamp, page.back().id);
+                    }
+
+                    if (!state->more || page.empty()) {
+                        chunk += "]";
+                        std::cout << "[/api/project/export] Streamed " << state->rows << " traces" << std::endl;
+                        return false;
+                    }
+                    return true;
+                } catch (const std::exception& e) {
+                    // The 200 header is already out: end the stream with the
+                    // array left open so the client sees the export failed.
+                    std::cerr << "[/api/project/export ERROR] " << e.what() << std::endl;
+                    chunk.resize(start);
+                    return false;
+                }
+            });
+            return resp;
+        } catch (const std::exception& e) {
+            crow::response resp(500, "{\"error\":\"Server error\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        }
+    });
+
+    CROW_ROUTE(app, "/api/project/<int>/segments").methods(crow::HTTPMethod::Delete)
+    ([](const crow::request& req, int project_id){
+        std::cout << "\n[/api/project/segments] Dropping old segments for project " << project_id << std::endl;
+
+        if (!has_project_key(req, project_id)) {
+            crow::response resp(401, "{\"error\":\"Invalid API key for this project\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        }
+
+        auto params = crow::query_string(req.url_params);
+        if (!params.get("before")) {
+            crow::response resp(400, "{\"error\":\"Missing 'before' timestamp\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        }
+
+        try {
+            int64_t before = std::stoll(params.get("before"));
+            size_t dropped = trace_db->drop_segments_before(project_id, before);
+
+            crow::response resp(200, "{\"status\":\"ok\",\"dropped\":" + std::to_string(dropped) + "}");
+            resp.add_header("Content-Type", "application/json");
+            resp.add_header("Access-Control-Allow-Origin", "*");
+            return resp;
+        } catch (const std::exception& e) {
+            crow::response resp(500, "{\"error\":\"Server error\"}");
+            resp.add_header("Content-Type", "application/json");
+            return resp;
+        }
+    });
     
+    webhooks = new WebhookSender(webhook_hosts_from_env());
+    std::atomic<bool> background_running(true);
+    std::thread background_thread(run_background_loop, std::ref(background_running));
+
     log_info("Server", "Starting on port 8080...");
     
     app.port(8080).run();
 
+    background_running = false;
+    background_thread.join();
+    delete webhooks;
+
     if (trace_db) {
         delete trace_db;
     }